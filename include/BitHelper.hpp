@@ -20,14 +20,14 @@ namespace BitHelper{
 template<typename T>
 T BitHelper::setBit(T bits, unsigned int i, bool value){
 	if (value)
-		return bits | (1 << i);
+		return bits | ((T)1 << i);
 
-	return bits & ~(1 << i);
+	return bits & ~((T)1 << i);
 }
 
 template<typename T>
 bool BitHelper::getBit(T bits, unsigned int i){
-	return ((1 << i) & bits) != 0;
+	return (((T)1 << i) & bits) != 0;
 }
 
 uint32_t BitHelper::back(uint64_t i){
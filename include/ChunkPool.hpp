@@ -2,6 +2,7 @@
 
 #include "BitHelper.hpp"
 #include "FlatStack.hpp"
+#include "WorkPool.hpp"
 
 #include <cstdint>
 #include <cassert>
@@ -10,12 +11,21 @@
 
 #include <iostream>
 
+// Every chunk starts on this boundary (chunks are spaced by the chunk size rounded up to it), so a block at the start of a chunk is aligned for any type up to it
+#ifndef CHUNK_ALIGNMENT
+#define CHUNK_ALIGNMENT 64
+#endif
+
 // ChunkPool: For creating varyingly sized blocks of pre-allocated memory while maintaining some-what contiguous memory (some-what as there's empty space at the top of each chunk).
 // Each chunk gets filled with contiguous blocks of data (tied to 32bit ids), and when full, another chunk is created for more space.
 // When an element is removed from a chunk, elements after it are copied over to maintain contiguous memory.
 // The chunk size is what dictates performance depending on the sizes of blocks being created, as a larger chunk size means less time allocating, and smaller chunk size means less time copying.
 
 class ChunkPool{
+public:
+	typedef void(*Relocate)(void* user, uint8_t* to, uint8_t* from, size_t size);
+
+private:
 	struct Location{
 		enum Flags{
 			LeftExists,
@@ -60,9 +70,14 @@ public:
 
 		bool _valid = true;
 
+		inline Iterator(ChunkPool& pool, uint32_t chunkIndex, uint32_t locationIndex);
+
+		friend class ChunkPool;
+
 	public:
 		inline Iterator(ChunkPool& pool, uint32_t id);
 		inline Iterator(ChunkPool& pool);
+		inline Iterator(const Iterator& other);
 
 		inline Iterator& operator=(const Iterator& other);
 
@@ -78,6 +93,15 @@ public:
 	friend class Iterator;
 
 private:
+	struct Range{
+		uint32_t chunkIndex;
+
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	// The aligned buffer sits somewhere inside the allocation
+	uint8_t* _allocation = nullptr;
 	uint8_t* _buffer = nullptr;
 	size_t _bufferSize = 0;
 
@@ -85,6 +109,7 @@ private:
 	uint32_t _chunkCount = 0;
 
 	const size_t _chunkSize;
+	const size_t _chunkStride;
 
 	uint64_t* _ids = nullptr;
 	uint32_t _idCount = 0;
@@ -93,6 +118,9 @@ private:
 
 	FlatStack<uint32_t> _excludedIds;
 
+	Relocate _relocate = nullptr;
+	void* _relocateUser = nullptr;
+
 	template <typename T>
 	inline T* _allocate(T* location, unsigned int count);
 
@@ -104,6 +132,8 @@ private:
 
 	inline uint8_t* _locationPointer(uint32_t chunkIndex, uint32_t locationIndex);
 
+	inline bool _visible(const Location& location) const;
+
 public:
 	inline ChunkPool(size_t chunkSize);
 	inline virtual ~ChunkPool();
@@ -114,8 +144,22 @@ public:
 
 	inline void erase(uint32_t id);
 
+	// Returns an iterator to the next block
+	inline Iterator erase(const Iterator& iterator);
+
+	// Erases every block the predicate picks, moving each survivor at most once (runs of survivors are moved together)
+	template <typename T>
+	inline unsigned int sweep(const T& predicate);
+
+	// Growing the buffer moves every block by realloc, unless this is set, then it's given the old and new buffers to move data that can't just be copied
+	inline void relocator(Relocate relocate, void* user);
+
 	inline Iterator begin();
 
+	// Chunks are independent, so whole chunks (or grain sized ranges of locations within them) are handed out to the workers
+	template <typename T>
+	inline void parallelForEach(WorkPool& workers, const T& lambda, uint32_t grain = 0, bool deterministic = false);
+
 	inline unsigned int count() const;
 
 	inline void activate(uint32_t id, bool active);
@@ -127,22 +171,38 @@ public:
 	inline void print() const;
 };
 
+ChunkPool::Iterator::Iterator(ChunkPool& pool, uint32_t chunkIndex, uint32_t locationIndex) : _pool(pool){
+	_chunkIndex = chunkIndex;
+	_locationIndex = locationIndex;
+
+	_id = _pool._chunks[_chunkIndex].locations[_locationIndex].id;
+}
+
 ChunkPool::Iterator::Iterator(ChunkPool& pool, uint32_t id) : _pool(pool){
 	_id = id;
 
 	uint64_t pair = _pool._ids[_id];
 
 	_chunkIndex = BitHelper::front(pair);
-	_locationIndex = BitHelper::front(pair);
+	_locationIndex = BitHelper::back(pair);
 }
 
 ChunkPool::Iterator::Iterator(ChunkPool& pool) : _pool(pool){
 	_valid = false;
 }
 
+ChunkPool::Iterator::Iterator(const Iterator& other) : _pool(other._pool){
+	_id = other._id;
+	_chunkIndex = other._chunkIndex;
+	_locationIndex = other._locationIndex;
+	_valid = other._valid;
+}
+
 ChunkPool::Iterator& ChunkPool::Iterator::operator=(const Iterator& other){
-	assert(other._valid);
+	// Invalid iterators (the end) copy like any other, but the pool can't change
+	assert(&_pool == &other._pool);
 
+	_id = other._id;
 	_chunkIndex = other._chunkIndex;
 	_locationIndex = other._locationIndex;
 	_valid = other._valid;
@@ -165,18 +225,31 @@ void ChunkPool::Iterator::next(){
 	if (!_valid)
 		return;
 
-	for (_chunkIndex; _chunkIndex < _pool._chunkCount; _chunkIndex++){
-		while (BitHelper::getBit(_pool._chunks[_chunkIndex].locations[_locationIndex].flags, Location::RightExists)){
-			_locationIndex = _pool._chunks[_chunkIndex].locations[_locationIndex].rightLocation;
+	while (_chunkIndex < _pool._chunkCount){
+		Location& current = _pool._chunks[_chunkIndex].locations[_locationIndex];
 
-			if (!BitHelper::getBit(_pool._chunks[_chunkIndex].locations[_locationIndex].flags, Location::Excluded) && BitHelper::getBit(_pool._chunks[_chunkIndex].locations[_locationIndex].flags, Location::Active)){
-				_id = _pool._chunks[_chunkIndex].locations[_locationIndex].id;
-				return;
-			}
+		if (BitHelper::getBit(current.flags, Location::RightExists)){
+			// Step right within chunk
+			_locationIndex = current.rightLocation;
+		}
+		else{
+			// Step to first location of next non-empty chunk
+			do{
+				_chunkIndex++;
+			} while (_chunkIndex < _pool._chunkCount && !_pool._chunks[_chunkIndex].locationCount);
+
+			if (_chunkIndex == _pool._chunkCount)
+				break;
+
+			_locationIndex = _pool._chunks[_chunkIndex].firstLocation;
 		}
 
-		if (_chunkIndex + 1 < _pool._chunkCount)
-			_locationIndex = _pool._chunks[_chunkIndex + 1].firstLocation;
+		Location& location = _pool._chunks[_chunkIndex].locations[_locationIndex];
+
+		if (_pool._visible(location)){
+			_id = location.id;
+			return;
+		}
 	}
 
 	_valid = false;
@@ -207,9 +280,36 @@ uint32_t ChunkPool::_pushChunk(){
 
 	_chunkCount++;
 
-	// Add memory buffer
-	_bufferSize += _chunkSize;
-	_buffer = _allocate(_buffer, (unsigned int)_bufferSize);
+	// Add memory buffer, with room to line the start up to the alignment
+	size_t offset = _buffer - _allocation;
+	size_t used = _bufferSize;
+
+	_bufferSize += _chunkStride;
+
+	if (_relocate && used){
+		// Both buffers need to exist at once for the relocator
+		uint8_t* allocation = _allocate((uint8_t*)nullptr, (unsigned int)(_bufferSize + CHUNK_ALIGNMENT - 1));
+		uint8_t* previous = _buffer;
+
+		_buffer = (uint8_t*)(((uintptr_t)allocation + CHUNK_ALIGNMENT - 1) & ~(uintptr_t)(CHUNK_ALIGNMENT - 1));
+
+		_relocate(_relocateUser, _buffer, previous, used);
+
+		std::free(_allocation);
+		_allocation = allocation;
+
+		return _chunkCount - 1;
+	}
+
+	_allocation = _allocate(_allocation, (unsigned int)(_bufferSize + CHUNK_ALIGNMENT - 1));
+
+	uint8_t* aligned = (uint8_t*)(((uintptr_t)_allocation + CHUNK_ALIGNMENT - 1) & ~(uintptr_t)(CHUNK_ALIGNMENT - 1));
+
+	// Realloc doesn't keep alignment, so shift the data if the allocation moved to a different offset
+	if ((size_t)(aligned - _allocation) != offset)
+		std::memmove(aligned, _allocation + offset, used);
+
+	_buffer = aligned;
 
 	return _chunkCount - 1;
 }
@@ -266,6 +366,9 @@ void ChunkPool::_eraseLocation(uint32_t chunkIndex, uint32_t locationIndex){
 
 	Location& location = chunk.locations[locationIndex];
 
+	// The slot is reused for the end location below, so take the size first
+	size_t size = location.endSize - location.startSize;
+
 	// Update adjacent locations to remove erased location
 	if (BitHelper::getBit(location.flags, Location::LeftExists) && BitHelper::getBit(location.flags, Location::RightExists)){
 		Location& left = chunk.locations[location.leftLocation];
@@ -306,12 +409,12 @@ void ChunkPool::_eraseLocation(uint32_t chunkIndex, uint32_t locationIndex){
 		// Update adjacent locations to point to new index
 		if (BitHelper::getBit(end.flags, Location::LeftExists)){
 			chunk.locations[end.leftLocation].rightLocation = location.index;
-			location.rightLocation = end.rightLocation;
+			location.leftLocation = end.leftLocation;
 		}
 
 		if (BitHelper::getBit(end.flags, Location::RightExists)){
 			chunk.locations[end.rightLocation].leftLocation = location.index;
-			location.leftLocation = end.leftLocation;
+			location.rightLocation = end.rightLocation;
 		}
 
 		// Update replaced location's id with new location
@@ -319,7 +422,7 @@ void ChunkPool::_eraseLocation(uint32_t chunkIndex, uint32_t locationIndex){
 	}
 
 	// Add to top size and available locations
-	chunk.topSize += location.endSize - location.startSize;
+	chunk.topSize += size;
 	chunk.locationCount--;
 	chunk.freeLocations++;
 }
@@ -327,10 +430,14 @@ void ChunkPool::_eraseLocation(uint32_t chunkIndex, uint32_t locationIndex){
 uint8_t* ChunkPool::_locationPointer(uint32_t chunkIndex, uint32_t locationIndex){
 	Location& location = _chunks[chunkIndex].locations[locationIndex];
 
-	return _buffer + (_chunkSize * chunkIndex) + location.startSize;
+	return _buffer + (_chunkStride * chunkIndex) + location.startSize;
 }
 
-ChunkPool::ChunkPool(size_t chunkSize) : _chunkSize(chunkSize){
+bool ChunkPool::_visible(const Location& location) const{
+	return BitHelper::getBit(location.flags, Location::Active) && !BitHelper::getBit(location.flags, Location::Excluded);
+}
+
+ChunkPool::ChunkPool(size_t chunkSize) : _chunkSize(chunkSize), _chunkStride((chunkSize + CHUNK_ALIGNMENT - 1) / CHUNK_ALIGNMENT * CHUNK_ALIGNMENT){
 	_pushChunk();
 }
 
@@ -346,8 +453,8 @@ ChunkPool::~ChunkPool(){
 	if (_ids)
 		std::free(_ids);
 
-	if (_buffer)
-		std::free(_buffer);
+	if (_allocation)
+		std::free(_allocation);
 }
 
 uint32_t ChunkPool::insert(size_t size, bool excluded){
@@ -451,7 +558,7 @@ void ChunkPool::erase(uint32_t id){
 	if (locationIndex != chunk.lastLocation){
 		uint8_t* pointer = _locationPointer(chunkIndex, locationIndex);
 
-		std::memcpy(pointer, pointer + size, _chunkSize - location.endSize);
+		std::memmove(pointer, pointer + size, _chunkSize - location.endSize);
 	}
 
 	// Erase location and push id onto free stack
@@ -460,20 +567,193 @@ void ChunkPool::erase(uint32_t id){
 	_freeIds.push(id);	
 }
 
+ChunkPool::Iterator ChunkPool::erase(const Iterator& iterator){
+	assert(iterator._valid);
+
+	// Step on while the links are intact, then find it again by id (ids survive an erase, positions don't)
+	Iterator next = iterator;
+	next.next();
+
+	erase(iterator._id);
+
+	if (!next._valid)
+		return next;
+
+	return Iterator(*this, next._id);
+}
+
+template <typename T>
+unsigned int ChunkPool::sweep(const T& predicate){
+	unsigned int erased = 0;
+
+	Location* kept = nullptr;
+	uint32_t keptCapacity = 0;
+
+	for (uint32_t chunkIndex = 0; chunkIndex < _chunkCount; chunkIndex++){
+		Chunk& chunk = _chunks[chunkIndex];
+
+		if (!chunk.locationCount)
+			continue;
+
+		if (chunk.locationCount > keptCapacity){
+			keptCapacity = chunk.locationCount;
+			kept = _allocate(kept, keptCapacity);
+		}
+
+		uint8_t* data = _buffer + (_chunkStride * chunkIndex);
+
+		uint32_t keptCount = 0;
+		size_t offset = 0;
+
+		// Survivors between erased blocks are contiguous, so they're moved down as one run
+		size_t runFrom = 0;
+		size_t runTo = 0;
+		size_t runSize = 0;
+
+		uint32_t index = chunk.firstLocation;
+
+		for (;;){
+			Location& location = chunk.locations[index];
+
+			size_t size = location.endSize - location.startSize;
+
+			// Only blocks after the current one have moved so far, so its data is still where its location says
+			if (_visible(location) && predicate(location.id, data + location.startSize)){
+				if (runSize && runTo != runFrom)
+					std::memmove(data + runTo, data + runFrom, runSize);
+
+				runSize = 0;
+
+				chunk.topSize += size;
+				_freeIds.push(location.id);
+				erased++;
+			}
+			else{
+				if (!runSize){
+					runFrom = location.startSize;
+					runTo = offset;
+				}
+
+				runSize += size;
+
+				Location& survivor = kept[keptCount];
+
+				survivor = location;
+				survivor.index = keptCount;
+				survivor.startSize = offset;
+				survivor.endSize = offset + size;
+
+				offset += size;
+				keptCount++;
+			}
+
+			if (!BitHelper::getBit(location.flags, Location::RightExists))
+				break;
+
+			index = location.rightLocation;
+		}
+
+		if (runSize && runTo != runFrom)
+			std::memmove(data + runTo, data + runFrom, runSize);
+
+		// Survivors are laid back out in order, so each location's neighbours are just either side of it
+		for (uint32_t i = 0; i < keptCount; i++){
+			Location& survivor = kept[i];
+
+			survivor.flags = BitHelper::setBit(survivor.flags, Location::LeftExists, i > 0);
+			survivor.flags = BitHelper::setBit(survivor.flags, Location::RightExists, i + 1 < keptCount);
+
+			survivor.leftLocation = i - 1;
+			survivor.rightLocation = i + 1;
+
+			_ids[survivor.id] = BitHelper::combine(chunkIndex, i);
+		}
+
+		if (keptCount)
+			std::memcpy(chunk.locations, kept, sizeof(Location) * keptCount);
+
+		chunk.freeLocations += chunk.locationCount - keptCount;
+		chunk.locationCount = keptCount;
+
+		chunk.firstLocation = 0;
+		chunk.lastLocation = keptCount ? keptCount - 1 : 0;
+	}
+
+	if (kept)
+		std::free(kept);
+
+	return erased;
+}
+
+void ChunkPool::relocator(Relocate relocate, void* user){
+	_relocate = relocate;
+	_relocateUser = user;
+}
+
 ChunkPool::Iterator ChunkPool::begin(){
 	for (unsigned int i = 0; i < _chunkCount; i++){
-		uint32_t locIndex = _chunks[i].firstLocation;
+		if (!_chunks[i].locationCount)
+			continue;
+
+		// Start at first location of first non-empty chunk, stepping on if it's hidden
+		Iterator iter(*this, i, _chunks[i].firstLocation);
 
-		while (BitHelper::getBit(_chunks[i].locations[locIndex].flags, Location::RightExists) && BitHelper::getBit(_chunks[i].locations[locIndex].flags, Location::Excluded) && !BitHelper::getBit(_chunks[i].locations[locIndex].flags, Location::Active))
-			locIndex = _chunks[i].locations[locIndex].rightLocation;
+		if (!_visible(_chunks[i].locations[_chunks[i].firstLocation]))
+			iter.next();
 
-		if (!BitHelper::getBit(_chunks[i].locations[locIndex].flags, Location::Excluded) && BitHelper::getBit(_chunks[i].locations[locIndex].flags, Location::Active))
-			return Iterator(*this, locIndex);
+		return iter;
 	}
 
 	return Iterator(*this);
 }
 
+template <typename T>
+void ChunkPool::parallelForEach(WorkPool& workers, const T& lambda, uint32_t grain, bool deterministic){
+	// Split each chunk's locations into ranges of grain size (or whole chunks if zero)
+	uint32_t rangeCount = 0;
+
+	for (uint32_t i = 0; i < _chunkCount; i++){
+		uint32_t count = _chunks[i].locationCount;
+
+		if (count)
+			rangeCount += grain ? (count + grain - 1) / grain : 1;
+	}
+
+	if (!rangeCount)
+		return;
+
+	Range* ranges = _allocate((Range*)nullptr, rangeCount);
+	uint32_t rangeIndex = 0;
+
+	for (uint32_t i = 0; i < _chunkCount; i++){
+		uint32_t count = _chunks[i].locationCount;
+		uint32_t step = grain ? grain : count;
+
+		for (uint32_t begin = 0; begin < count; begin += step){
+			Range& range = ranges[rangeIndex++];
+
+			range.chunkIndex = i;
+			range.begin = begin;
+			range.end = begin + step < count ? begin + step : count;
+		}
+	}
+
+	// Each location is independent, so ranges walk location arrays directly rather than following links
+	workers.run(rangeCount, [&](uint32_t task){
+		const Range& range = ranges[task];
+		Chunk& chunk = _chunks[range.chunkIndex];
+
+		for (uint32_t i = range.begin; i < range.end; i++){
+			Location& location = chunk.locations[i];
+
+			if (_visible(location))
+				lambda(location.id, _locationPointer(range.chunkIndex, i));
+		}
+	}, deterministic);
+
+	std::free(ranges);
+}
+
 unsigned int ChunkPool::count() const{
 	unsigned int count = 0;
 
@@ -0,0 +1,404 @@
+#pragma once
+
+#include "TypePool.hpp"
+#include "WorkPool.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+
+// CommandBuffer: Records structural changes to a TypePool (insert, erase, adding and removing types) to be played back later in one batch.
+// Changing a pool while executing over it moves blocks around under the running lambda, so changes made from inside execute should go through one of these instead.
+// There's one buffer per WorkPool worker (picked with WorkPool::worker()), so lambdas run by executeParallel can record without locking (any workers past that share one more, behind a lock).
+// Commands are stored back to back in flat malloc'd arrays, and play() runs each worker's commands in the order they were recorded, worker 0 first.
+// Like the pool itself, recorded values of trivial types are copied as raw bytes (each into its own aligned slot), anything else is kept on the heap until played back (or the buffer is destroyed).
+
+/*
+CommandBuffer commands(pool, workers);
+
+pool.executeParallel(workers, [&](const TypePool::Mask& mask, const Dog* dog){
+	if (dog->x)
+		commands.insert<Dog, Banana>(*dog, Banana());	// Inserted with these values
+});
+
+commands.play();		// After execution, ids are only valid from here
+*/
+
+class CommandBuffer{
+	typedef void(*Play)(TypePool& pool, uint8_t* data);
+	typedef void(*Discard)(uint8_t* data);
+
+	struct Command{
+		Play play;
+		Discard discard;
+
+		// Bytes to the next command, and to this one's payload
+		size_t size;
+		size_t offset;
+	};
+
+	template <typename ...Args>
+	struct Trivial{
+		static const bool value = true;
+	};
+
+	template <typename T, typename ...Args>
+	struct Trivial<T, Args...>{
+		static const bool value = std::is_trivially_copyable<T>::value && Trivial<Args...>::value;
+	};
+
+	template <typename ...Args>
+	struct Alignment{
+		static const size_t value = 1;
+	};
+
+	template <typename T, typename ...Args>
+	struct Alignment<T, Args...>{
+		static const size_t value = alignof(T) > Alignment<Args...>::value ? alignof(T) : Alignment<Args...>::value;
+	};
+
+	// Inserts give every type a count of 1, which for a shared type would be a share handle
+	template <typename ...Args>
+	struct Unshared{
+		static const bool value = true;
+	};
+
+	template <typename T, typename ...Args>
+	struct Unshared<T, Args...>{
+		static const bool value = Unshared<Args...>::value;
+	};
+
+	template <typename T, typename ...Args>
+	struct Unshared<TypePool::Shared<T>, Args...>{
+		static const bool value = false;
+	};
+
+	// The data sits somewhere inside the allocation, on a CHUNK_ALIGNMENT boundary (the most any pool type can ask for)
+	struct Buffer{
+		uint8_t* allocation = nullptr;
+		uint8_t* data = nullptr;
+		size_t size = 0;
+		size_t capacity = 0;
+	};
+
+	// Every command starts on this boundary, payloads on their own alignment if it's more
+	static const size_t _alignment = alignof(std::max_align_t);
+
+	static inline size_t _aligned(size_t size, size_t alignment = _alignment);
+
+	template <typename ...Args>
+	static inline void _assign(TypePool& pool, std::tuple<Args...>& values);
+
+	// Where each trivial value goes in a record, returning the record's size
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I == sizeof...(Args), size_t>::type _slots(size_t* offsets, size_t offset);
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I <sizeof...(Args), size_t>::type _slots(size_t* offsets, size_t offset);
+
+	static inline void _store(uint8_t* data, const size_t* offsets);
+
+	template <typename T, typename ...Args>
+	static inline void _store(uint8_t* data, const size_t* offsets, const T& value, const Args&... values);
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I == sizeof...(Args), void>::type _load(TypePool& pool, uint32_t id, const uint8_t* data, const size_t* offsets);
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I <sizeof...(Args), void>::type _load(TypePool& pool, uint32_t id, const uint8_t* data, const size_t* offsets);
+
+	template <typename ...Args>
+	static inline void _insert(TypePool& pool, uint8_t* data);
+
+	template <typename ...Args>
+	static inline void _insertOwned(TypePool& pool, uint8_t* data);
+
+	template <typename ...Args>
+	static inline void _discardOwned(uint8_t* data);
+
+	static inline void _erase(TypePool& pool, uint8_t* data);
+
+	template <typename T>
+	static inline void _addComponent(TypePool& pool, uint8_t* data);
+
+	template <typename T>
+	static inline void _removeComponent(TypePool& pool, uint8_t* data);
+
+	TypePool& _pool;
+
+	// One per worker, and one more shared by workers past those
+	Buffer* _buffers = nullptr;
+	const unsigned int _bufferCount;
+
+	std::mutex _overflow;
+
+	inline uint8_t* _append(Buffer& buffer, Play play, size_t size, size_t alignment, Discard discard);
+
+	template <typename T>
+	inline void _record(Play play, size_t size, const T& write, size_t alignment = _alignment, Discard discard = nullptr);
+
+	template <typename ...Args>
+	inline typename std::enable_if<Trivial<Args...>::value, void>::type _recordInsert(const Args&... values);
+
+	template <typename ...Args>
+	inline typename std::enable_if<!Trivial<Args...>::value, void>::type _recordInsert(const Args&... values);
+
+public:
+	inline CommandBuffer(TypePool& pool, unsigned int workers = 1);
+	inline CommandBuffer(TypePool& pool, const WorkPool& workers);
+	inline ~CommandBuffer();
+
+	template <typename ...Args>
+	inline void insert(const Args&... values);
+
+	inline void erase(uint32_t id);
+
+	template <typename T>
+	inline void addComponent(uint32_t id, unsigned int count = 1);
+
+	template <typename T>
+	inline void removeComponent(uint32_t id);
+
+	inline void play();
+
+	inline bool empty() const;
+};
+
+size_t CommandBuffer::_aligned(size_t size, size_t alignment){
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+template <typename ...Args>
+void CommandBuffer::_assign(TypePool& pool, std::tuple<Args...>& values){
+	uint32_t id = pool.insert<Args...>(((void)sizeof(Args), 1)...);
+
+	int assigned[] = { 0, (*pool.get<Args>(id) = std::move(std::get<Args>(values)), 0)... };
+	(void)assigned;
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), size_t>::type CommandBuffer::_slots(size_t* offsets, size_t offset){
+	return offset;
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), size_t>::type CommandBuffer::_slots(size_t* offsets, size_t offset){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+	offsets[I] = _aligned(offset, alignof(T));
+
+	return _slots<I + 1, Args...>(offsets, offsets[I] + sizeof(T));
+}
+
+void CommandBuffer::_store(uint8_t* data, const size_t* offsets){}
+
+template <typename T, typename ...Args>
+void CommandBuffer::_store(uint8_t* data, const size_t* offsets, const T& value, const Args&... values){
+	std::memcpy(data + offsets[0], &value, sizeof(T));
+
+	_store(data, offsets + 1, values...);
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), void>::type CommandBuffer::_load(TypePool& pool, uint32_t id, const uint8_t* data, const size_t* offsets){}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), void>::type CommandBuffer::_load(TypePool& pool, uint32_t id, const uint8_t* data, const size_t* offsets){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+
+	// Copied straight into the block, tags have nothing to copy
+	if (!std::is_empty<T>::value)
+		std::memcpy(pool.get<T>(id), data + offsets[I], sizeof(T));
+
+	_load<I + 1, Args...>(pool, id, data, offsets);
+}
+
+template <typename ...Args>
+void CommandBuffer::_insert(TypePool& pool, uint8_t* data){
+	size_t offsets[sizeof...(Args) + 1];
+	_slots<0, Args...>(offsets, 0);
+
+	uint32_t id = pool.insert<Args...>(((void)sizeof(Args), 1)...);
+
+	_load<0, Args...>(pool, id, data, offsets);
+}
+
+template <typename ...Args>
+void CommandBuffer::_insertOwned(TypePool& pool, uint8_t* data){
+	_assign<Args...>(pool, **(std::tuple<Args...>**)data);
+	_discardOwned<Args...>(data);
+}
+
+template <typename ...Args>
+void CommandBuffer::_discardOwned(uint8_t* data){
+	delete *(std::tuple<Args...>**)data;
+}
+
+void CommandBuffer::_erase(TypePool& pool, uint8_t* data){
+	pool.erase(*(uint32_t*)data);
+}
+
+template <typename T>
+void CommandBuffer::_addComponent(TypePool& pool, uint8_t* data){
+	pool.addComponent<T>(((uint32_t*)data)[0], ((uint32_t*)data)[1]);
+}
+
+template <typename T>
+void CommandBuffer::_removeComponent(TypePool& pool, uint8_t* data){
+	pool.removeComponent<T>(*(uint32_t*)data);
+}
+
+uint8_t* CommandBuffer::_append(Buffer& buffer, Play play, size_t size, size_t alignment, Discard discard){
+	assert(alignment <= CHUNK_ALIGNMENT);
+
+	// Offsets from the (aligned) start of the data, so payloads are aligned in memory too
+	size_t payload = _aligned(buffer.size + sizeof(Command), alignment > _alignment ? alignment : _alignment);
+	size_t end = _aligned(payload + size);
+
+	// Grow geometrically, commands are often recorded by the thousand
+	if (end > buffer.capacity){
+		size_t offset = buffer.data - buffer.allocation;
+
+		buffer.capacity = buffer.capacity * 2 > end ? buffer.capacity * 2 : end;
+		buffer.allocation = (uint8_t*)std::realloc(buffer.allocation, buffer.capacity + CHUNK_ALIGNMENT - 1);
+
+		uint8_t* aligned = (uint8_t*)(((uintptr_t)buffer.allocation + CHUNK_ALIGNMENT - 1) & ~(uintptr_t)(CHUNK_ALIGNMENT - 1));
+
+		// Realloc doesn't keep alignment, commands are only ever plain bytes (or pointers) so can be shifted
+		if ((size_t)(aligned - buffer.allocation) != offset)
+			std::memmove(aligned, buffer.allocation + offset, buffer.size);
+
+		buffer.data = aligned;
+	}
+
+	Command* command = (Command*)(buffer.data + buffer.size);
+
+	command->play = play;
+	command->discard = discard;
+	command->size = end - buffer.size;
+	command->offset = payload - buffer.size;
+
+	buffer.size = end;
+
+	return buffer.data + payload;
+}
+
+template <typename T>
+void CommandBuffer::_record(Play play, size_t size, const T& write, size_t alignment, Discard discard){
+	unsigned int worker = WorkPool::worker();
+
+	if (worker < _bufferCount){
+		write(_append(_buffers[worker], play, size, alignment, discard));
+		return;
+	}
+
+	// Held until the payload is written, another worker appending could move the buffer
+	std::lock_guard<std::mutex> lock(_overflow);
+
+	write(_append(_buffers[_bufferCount], play, size, alignment, discard));
+}
+
+CommandBuffer::CommandBuffer(TypePool& pool, unsigned int workers) : _pool(pool), _bufferCount(workers ? workers : 1){
+	_buffers = new Buffer[_bufferCount + 1];
+}
+
+CommandBuffer::CommandBuffer(TypePool& pool, const WorkPool& workers) : CommandBuffer(pool, workers.workers()){}
+
+CommandBuffer::~CommandBuffer(){
+	for (unsigned int i = 0; i <= _bufferCount; i++){
+		Buffer& buffer = _buffers[i];
+
+		// Commands never played back may still own values
+		for (size_t offset = 0; offset < buffer.size;){
+			Command* command = (Command*)(buffer.data + offset);
+
+			if (command->discard)
+				command->discard((uint8_t*)command + command->offset);
+
+			offset += command->size;
+		}
+
+		if (buffer.allocation)
+			std::free(buffer.allocation);
+	}
+
+	delete[] _buffers;
+}
+
+template <typename ...Args>
+typename std::enable_if<CommandBuffer::Trivial<Args...>::value, void>::type CommandBuffer::_recordInsert(const Args&... values){
+	size_t offsets[sizeof...(Args) + 1];
+	size_t size = _slots<0, Args...>(offsets, 0);
+
+	_record(&_insert<Args...>, size, [&](uint8_t* data){
+		_store(data, offsets, values...);
+	}, Alignment<Args...>::value);
+}
+
+template <typename ...Args>
+typename std::enable_if<!CommandBuffer::Trivial<Args...>::value, void>::type CommandBuffer::_recordInsert(const Args&... values){
+	// Buffers grow by realloc, so only a pointer to the values is stored
+	std::tuple<Args...>* tuple = new std::tuple<Args...>(values...);
+
+	_record(&_insertOwned<Args...>, sizeof(tuple), [&](uint8_t* data){
+		*(std::tuple<Args...>**)data = tuple;
+	}, alignof(std::tuple<Args...>*), &_discardOwned<Args...>);
+}
+
+template <typename ...Args>
+void CommandBuffer::insert(const Args&... values){
+	static_assert(Unshared<Args...>::value, "Shared types can't be inserted through a CommandBuffer, add them with addComponent and a share handle");
+
+	_recordInsert<Args...>(values...);
+}
+
+void CommandBuffer::erase(uint32_t id){
+	_record(&_erase, sizeof(uint32_t), [&](uint8_t* data){
+		*(uint32_t*)data = id;
+	});
+}
+
+template <typename T>
+void CommandBuffer::addComponent(uint32_t id, unsigned int count){
+	_record(&_addComponent<T>, sizeof(uint32_t) * 2, [&](uint8_t* data){
+		((uint32_t*)data)[0] = id;
+		((uint32_t*)data)[1] = count;
+	});
+}
+
+template <typename T>
+void CommandBuffer::removeComponent(uint32_t id){
+	_record(&_removeComponent<T>, sizeof(uint32_t), [&](uint8_t* data){
+		*(uint32_t*)data = id;
+	});
+}
+
+void CommandBuffer::play(){
+	for (unsigned int i = 0; i <= _bufferCount; i++){
+		Buffer& buffer = _buffers[i];
+
+		for (size_t offset = 0; offset < buffer.size;){
+			Command* command = (Command*)(buffer.data + offset);
+
+			command->play(_pool, (uint8_t*)command + command->offset);
+
+			offset += command->size;
+		}
+
+		// Keep the memory for next time
+		buffer.size = 0;
+	}
+}
+
+bool CommandBuffer::empty() const{
+	for (unsigned int i = 0; i <= _bufferCount; i++){
+		if (_buffers[i].size)
+			return false;
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "TypePool.hpp"
+#include "WorkPool.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Scheduler: Runs a frame's worth of TypePool systems (execute lambdas) concurrently on a WorkPool.
+// Each system's read and write sets are taken from its lambda parameters, and a system depends on every earlier added system it conflicts with (a write alongside any access of the same type).
+// Systems run in the order they were added except where no dependency exists between them, so results are the same as calling execute for each one in turn.
+// Every system keeps its own TypePool::Query, so matching archetypes are only worked out again when new ones appear.
+
+/*
+Scheduler scheduler(pool, workers);
+
+scheduler.add([](const TypePool::Mask& mask, Dog* dog){}, "Dogs");							// Writes Dog
+scheduler.add([](const TypePool::Mask& mask, Puzzle* puzzle){}, "Puzzles");					// Runs alongside "Dogs"
+scheduler.add([](const TypePool::Mask& mask, const Dog* dog, Banana* banana){}, "Bananas");	// Waits for "Dogs"
+
+scheduler.run();		// Every frame
+scheduler.print();		// Timings
+*/
+
+class Scheduler{
+	struct System{
+		std::function<void()> execute;
+
+		TypePool::Access access;
+		TypePool::Query query;
+
+		const char* name;
+
+		std::vector<uint32_t> dependencies;
+
+		double lastTime = 0.0;
+		double totalTime = 0.0;
+	};
+
+	TypePool& _pool;
+	WorkPool& _workers;
+
+	std::vector<System> _systems;
+
+	std::atomic<bool>* _finished = nullptr;
+
+	uint32_t _frames = 0;
+	double _lastFrameTime = 0.0;
+
+	inline void _runSystem(uint32_t index);
+
+public:
+	inline Scheduler(TypePool& pool, WorkPool& workers);
+	inline ~Scheduler();
+
+	template <typename T>
+	inline uint32_t add(const T& lambda, const char* name = nullptr);
+
+	inline void run();
+
+	inline uint32_t count() const;
+
+	inline bool dependsOn(uint32_t system, uint32_t other) const;
+
+	inline double lastTime(uint32_t system) const;
+
+	inline double averageTime(uint32_t system) const;
+
+	inline double lastFrameTime() const;
+
+	inline void print() const;
+};
+
+void Scheduler::_runSystem(uint32_t index){
+	System& system = _systems[index];
+
+	// Dependencies always have a lower index and workers take their tasks in ascending order, so whatever we wait on never waits on us
+	for (uint32_t dependency : system.dependencies){
+		while (!_finished[dependency].load(std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	system.execute();
+
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	system.lastTime = elapsed.count();
+	system.totalTime += system.lastTime;
+
+	_finished[index].store(true, std::memory_order_release);
+}
+
+Scheduler::Scheduler(TypePool& pool, WorkPool& workers) : _pool(pool), _workers(workers){}
+
+Scheduler::~Scheduler(){
+	if (_finished)
+		delete[] _finished;
+}
+
+template <typename T>
+uint32_t Scheduler::add(const T& lambda, const char* name){
+	uint32_t index = (uint32_t)_systems.size();
+
+	_systems.emplace_back();
+
+	System& system = _systems.back();
+
+	system.execute = [this, lambda, index]{
+		_pool.execute(_systems[index].query, lambda);
+	};
+
+	system.access = TypePool::access(lambda);
+	system.name = name;
+
+	// Depend on every earlier system touching the same data
+	for (uint32_t i = 0; i < index; i++){
+		if (system.access.conflicts(_systems[i].access))
+			system.dependencies.push_back(i);
+	}
+
+	if (_finished)
+		delete[] _finished;
+
+	_finished = new std::atomic<bool>[_systems.size()];
+
+	return index;
+}
+
+void Scheduler::run(){
+	uint32_t systemCount = count();
+
+	for (uint32_t i = 0; i < systemCount; i++)
+		_finished[i].store(false, std::memory_order_relaxed);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	_workers.run(systemCount, [this](uint32_t task){
+		_runSystem(task);
+	});
+
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	_lastFrameTime = elapsed.count();
+	_frames++;
+}
+
+uint32_t Scheduler::count() const{
+	return (uint32_t)_systems.size();
+}
+
+bool Scheduler::dependsOn(uint32_t system, uint32_t other) const{
+	assert(system < count());
+
+	for (uint32_t dependency : _systems[system].dependencies){
+		if (dependency == other)
+			return true;
+	}
+
+	return false;
+}
+
+double Scheduler::lastTime(uint32_t system) const{
+	assert(system < count());
+	return _systems[system].lastTime;
+}
+
+double Scheduler::averageTime(uint32_t system) const{
+	assert(system < count());
+
+	if (!_frames)
+		return 0.0;
+
+	return _systems[system].totalTime / _frames;
+}
+
+double Scheduler::lastFrameTime() const{
+	return _lastFrameTime;
+}
+
+void Scheduler::print() const{
+	std::cout << "\n-------------\n";
+	std::cout << "Frame:\t" << _lastFrameTime << " us\n\n";
+
+	for (uint32_t i = 0; i < count(); i++){
+		const System& system = _systems[i];
+
+		std::cout << "System:\t" << i;
+
+		if (system.name)
+			std::cout << " (" << system.name << ")";
+
+		std::cout << "\n";
+		std::cout << " Last:\t" << system.lastTime << " us\n";
+		std::cout << " Avg:\t" << averageTime(i) << " us\n";
+
+		if (!system.dependencies.empty()){
+			std::cout << " After:\t";
+
+			for (uint32_t dependency : system.dependencies)
+				std::cout << dependency << " ";
+
+			std::cout << "\n";
+		}
+
+		std::cout << "\n";
+	}
+}
\ No newline at end of file
@@ -2,333 +2,2443 @@
 
 #include "ChunkPool.hpp"
 #include "BitHelper.hpp"
+#include "FlatStack.hpp"
+#include "WorkPool.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
+#include <new>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 
 #ifndef MAX_TYPES
-#define MAX_TYPES 16
+#define MAX_TYPES 256
 #endif
 
+// Ids below this are left for types given a fixed id with TYPEPOOL_TYPE, the rest are handed out automatically
+#ifndef RESERVED_TYPES
+#define RESERVED_TYPES 32
+#endif
+
+static_assert(RESERVED_TYPES <= MAX_TYPES, "RESERVED_TYPES can't be more than MAX_TYPES");
+
+// Gives a type a fixed compile time id, the same in every build (use at global scope right after the type is declared, so every translation unit sees it)
+#define TYPEPOOL_TYPE(Type, Id) \
+	static_assert((Id) < RESERVED_TYPES, "TYPEPOOL_TYPE ids must be below RESERVED_TYPES"); \
+	template <> struct TypePool::TypeId<Type>{ static constexpr uint32_t value(){ return (Id); } };
+
 // TypePool: An extension of ChunkPool for storing groups of data types and iterating over them using lambdas with type pointers as parameters.
-// Each block of memory allocated in the ChunkPool has a mask describing what objects that block contains, masks being automatically created from template and lambda arguments.
-// The lambda iterator will only iterate over blocks containing the data types provided as pointers in the lambda parameters.
+// Each block has a mask describing what objects that block contains, masks being automatically created from template and lambda arguments.
+// Blocks with the same mask (an archetype) share a layout and are stored together in their own chunks.
+// The lambda iterator only iterates over archetypes containing the data types provided as pointers in the lambda parameters.
+
+/*
+pool.insert<Banana, Dog, Puzzle>(1, 1, 1);				// Will iterate over (arguments are how many of each type)
+pool.insert<Banana, Dog, Wizard, Puzzle>(1, 1, 1, 5);	// Will iterate over (5 of Puzzle for array example)
+pool.insert<Banana, Dog>(1, 1, 1);						// Will NOT iterate over (doesn't contain Puzzle)
+
+pool.execute([](const TypePool::Mask& mask, Banana* banana, Dog* dog, Puzzle* puzzle){   // Data types provided as pointers in the lambda arguments (mask is a required arg for pool lambdas)	
+	
+	// Do stuff here
+	
+	for (unsigned int i = 0; i < mask.length<Puzzle(); i++){
+		puzzle[i];		// Array example
+	}
+
+	return;
+});
+
+pool.executeParallel(workers, [](const TypePool::Mask& mask, const Banana* banana, Dog* dog){	// Same, but blocks are split across a WorkPool (Banana is read-only)
+	
+	// Do stuff here
+});
+
+TypePool::Query query;		// Kept between frames
+
+pool.execute(query, [](const TypePool::Mask& mask, Dog* dog){});
+
+pool.execute([](const TypePool::Mask& mask, Dog* dog, TypePool::Optional<Wizard>* wizard, TypePool::Without<Puzzle>*){
+	if (wizard)
+		wizard->x;		// Optional<Wizard> is a Wizard
+});
+
+pool.executeBatch([](const TypePool::Mask& mask, uint32_t count, const uint32_t* ids, Dog* dogs, const Banana* bananas){
+	for (uint32_t i = 0; i < count; i++)
+		dogs[i].x += bananas[i].x;		// Arrays are mask.length<Dog>() apart
+});
+
+pool.execute([](const TypePool::Mask& mask, const TypePool::Changed<Dog>* dog, Banana* banana){});	// Only blocks whose Dog changed since the last tick()
+
+uint32_t mesh = pool.share(Mesh());									// Stored once
+uint32_t rock = pool.insert<Dog, TypePool::Shared<Mesh>>(1, mesh);		// Handle given instead of a count
+
+pool.executeBatch([](const TypePool::Mask& mask, uint32_t count, const uint32_t* ids, Dog* dogs, const TypePool::Shared<Mesh>* mesh){});	// Not an array
+
+uint32_t moving = pool.insert<Dog, TypePool::Previous<Dog>>(1, 1);		// Double buffered Dog
+
+pool.executeParallel(workers, [](const TypePool::Mask& mask, Dog* dog, const TypePool::Previous<Dog>* previous){
+	dog->x = previous->x + 1;		// Last frame's value, safe alongside systems writing Dog
+});
+
+TypePool::Cursor cursor;		// Kept between frames
+
+bool finished = pool.execute(cursor, std::chrono::microseconds(200), [](const TypePool::Mask& mask, Dog* dog){});	// Or a number of blocks
+
+pool.tick();		// Once a frame
+
+uint32_t ids[1000];
+
+pool.spawn<Dog, Banana>(1000, ids, 1, 1);		// Many blocks of one layout at once (ids can be nullptr)
+pool.clone(ids[0], 1000);						// Copies of an existing block
+
+Dog* dog;
+Banana* banana;
+
+std::tie(dog, banana) = pool.get<Dog, Banana>(id);		// One lookup for several types
+
+pool.addComponent<Wizard>(id, 1);		// Same id, existing types are carried over
+pool.removeComponent<Dog>(id);
+*/
+
+class TypePool{
+	static const uint32_t _maskWords = (MAX_TYPES + 63) / 64;
+
+	struct Bits{
+		uint64_t words[_maskWords] = {};
+
+		inline void set(uint32_t i, bool value);
+		inline bool get(uint32_t i) const;
+
+		inline bool fits(const Bits& other) const;
+		inline bool intersects(const Bits& other) const;
+
+		inline bool operator==(const Bits& other) const;
+	};
+
+	struct Filter{
+		Bits required;
+		Bits excluded;
+
+		inline bool matches(const Bits& bits) const;
+
+		inline bool operator==(const Filter& other) const;
+	};
+
+	// What a lambda parameter asks for, its type with const and any filter stripped
+	template <typename T>
+	struct Parameter{
+		using Type = T;
+
+		static const bool optional = false;
+		static const bool excluded = false;
+		static const bool changed = false;
+		static const bool shared = false;
+
+		// Tags have nothing to point at
+		static const bool stored = !std::is_empty<T>::value;
+	};
+
+	// Whether any of a lambda's parameters need block data
+	template <typename ...Args>
+	struct Stored{
+		static const bool value = false;
+	};
+
+	// Whether any of a lambda's parameters only want changed blocks
+	template <typename ...Args>
+	struct Tracked{
+		static const bool value = false;
+	};
+
+public:
+	template <typename T>
+	struct TypeId{
+		static inline uint32_t value();
+	};
+
+	// Lambda parameter filters, Optional<T> and Changed<T> derive from T so can be used in its place
+	template <typename T>
+	struct Optional : T{};
+
+	template <typename T>
+	struct Without{};
+
+	// Only blocks whose T changed (inserted, or written through a non-const pointer) since the last tick()
+	template <typename T>
+	struct Changed : T{};
+
+	// One T shared by every block in an archetype, kept outside the blocks (created with share<T>()), only const in parallel lambdas
+	template <typename T>
+	struct Shared : T{};
+
+	// A second copy of T holding its value as of the last tick(), stored as a type of its own (insert it alongside T to double buffer T)
+	template <typename T>
+	struct Previous : T{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be double buffered");
+	};
+
+	// Interleaved keeps each block's types together, Columns keeps one contiguous column per type per chunk
+	enum Layout{
+		Interleaved,
+		Columns
+	};
+
+	class Mask{
+		Bits _bits;
+		uint8_t* _counts = nullptr;
+
+	public:		
+		template <typename T>
+		inline unsigned int length() const;
+
+		friend class TypePool;
+	};
+
+	class Access{
+		Bits _read;
+		Bits _write;
+
+	public:
+		template <typename T>
+		inline bool reads() const;
+
+		template <typename T>
+		inline bool writes() const;
+
+		inline bool conflicts(const Access& other) const;
+
+		friend class TypePool;
+	};
+
+	class Query{
+		Filter _filter;
+
+		uint32_t* _matches = nullptr;
+		uint32_t _matchCount = 0;
+
+		uint32_t _testedCount = 0;
+
+	public:
+		Query() = default;
+		inline Query(Query&& other) noexcept;
+		inline ~Query();
+
+		Query(const Query& other) = delete;
+		Query& operator=(const Query& other) = delete;
+
+		friend class TypePool;
+	};
+
+	// Where a time sliced execute got to, kept between frames (still valid after blocks are inserted or erased)
+	class Cursor{
+		Query _query;
+
+		uint32_t _match = 0;
+
+		// Blocks before this in the current archetype are still to be visited (UINT32_MAX until it's started)
+		uint32_t _block = UINT32_MAX;
+
+		uint32_t _passes = 0;
+
+	public:
+		inline uint32_t passes() const;
+
+		friend class TypePool;
+	};
+
+private:
+	template <typename T>
+	struct Parameter<const T> : Parameter<T>{};
+
+	template <typename T>
+	struct Parameter<Optional<T>> : Parameter<T>{
+		static const bool optional = true;
+	};
+
+	template <typename T>
+	struct Parameter<Without<T>> : Parameter<T>{
+		static const bool excluded = true;
+		static const bool stored = false;
+	};
+
+	// Shared types have their own ids and data, just not in blocks
+	template <typename T>
+	struct Parameter<Shared<T>> : Parameter<T>{
+		using Type = Shared<T>;
+
+		static const bool shared = true;
+		static const bool stored = false;
+	};
+
+	template <typename T>
+	struct Parameter<Changed<T>> : Parameter<T>{
+		static_assert(!std::is_empty<T>::value, "Changes aren't tracked for tags");
+
+		static const bool changed = true;
+	};
+
+	template <typename T, typename ...Args>
+	struct Stored<T, Args...>{
+		static const bool value = Parameter<T>::stored || Stored<Args...>::value;
+	};
+
+	// Which type a type is a copy of, if any
+	template <typename T>
+	struct Buffer{
+		static inline uint32_t source();
+	};
+
+	template <typename T>
+	struct Buffer<Previous<T>>{
+		static inline uint32_t source();
+	};
+
+	template <typename T, typename ...Args>
+	struct Tracked<T, Args...>{
+		static const bool value = Parameter<T>::changed || Tracked<Args...>::value;
+	};
+
+	// Whether a lambda's parameters (as a tuple of pointers) write a shared value, which every worker would be given at once
+	template <typename T>
+	struct SharedWrite{
+		static const bool value = false;
+	};
+
+	template <typename T, typename ...Args>
+	struct SharedWrite<std::tuple<T*, Args*...>>{
+		static const bool value = (Parameter<T>::shared && !std::is_const<T>::value) || SharedWrite<std::tuple<Args*...>>::value;
+	};
+
+	struct TypeInfo{
+		uint32_t id;
+		uint32_t size;
+		uint32_t align;
+
+		// Left null for types that can just be zeroed, memcpy'd and forgotten
+		void(*construct)(uint8_t* data, uint32_t count);
+		void(*destroy)(uint8_t* data, uint32_t count);
+		void(*relocate)(uint8_t* to, uint8_t* from, uint32_t count);
+		void(*copy)(uint8_t* to, const uint8_t* from, uint32_t count);
+
+		// For Previous<T> the id of T, MAX_TYPES otherwise
+		uint32_t source;
+
+		bool shared;
+	};
+
+	struct SharedValues{
+		uint8_t** values = nullptr;
+		uint32_t count = 0;
+
+		void(*destroy)(uint8_t* value) = nullptr;
+	};
+
+	struct Edge{
+		uint32_t type;
+		uint32_t count;
+
+		uint32_t archetypeIndex;
+	};
+
+	struct Archetype{
+		// Of the mask and shared handles, for finding it again
+		uint64_t hash;
+
+		size_t blockSize;
+		uint32_t blocksPerChunk;
+
+		// Where each type starts in a chunk and how far apart consecutive blocks' data are
+		uint32_t starts[MAX_TYPES];
+		uint32_t strides[MAX_TYPES];
+
+		// Which of its type's shared values each shared type refers to (part of what makes the archetype)
+		uint32_t handles[MAX_TYPES];
+
+		// Types actually present, and how many bytes of each a block holds
+		TypeInfo* types = nullptr;
+		uint32_t* sizes = nullptr;
+		uint32_t typeCount = 0;
+
+		// No type has any hooks
+		bool trivial = true;
+
+		uint32_t* chunks = nullptr;
+		uint32_t chunkCount = 0;
+
+		uint32_t* ids = nullptr;
+		uint32_t count = 0;
+
+		// Archetypes reached before by changing one type's count
+		Edge* edges = nullptr;
+		uint32_t edgeCount = 0;
+
+		// Per chunk, the tick each type last changed anywhere in the chunk, followed by a column of ticks per type for each block (only with stored types)
+		uint32_t* ticks = nullptr;
+	};
+
+	struct Range{
+		uint32_t archetypeIndex;
+		uint32_t chunkIndex;
+
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	const size_t _chunkSize;
+
+	const Layout _layout;
+
+	ChunkPool _pool;
+
+	Archetype* _archetypes = nullptr;
+	uint32_t _archetypeCount = 0;
+	uint32_t _archetypeCapacity = 0;
+
+	// Indexed by archetype, kept apart from the archetypes themselves so matching walks nothing but bits
+	Bits* _maskBits = nullptr;
+	uint8_t* _maskBuffer = nullptr;
+
+	// Open addressed by archetype hash (a power of two long), holding archetype index + 1 so 0 is empty
+	uint32_t* _archetypeTable = nullptr;
+	uint32_t _archetypeTableSize = 0;
+
+	uint64_t* _ids = nullptr;
+	uint32_t _idCount = 0;
+	uint32_t _idCapacity = 0;
+
+	FlatStack<uint32_t> _freeIds;
+
+	// Values of each shared type, indexed by handle - 1
+	SharedValues _shared[MAX_TYPES];
+
+	// Changes are stamped with this, and Changed<T> means stamped since the last tick()
+	uint32_t _tick = 1;
+	
+	//uint32_t* _versions = nullptr; // TODO: Reintegrate 64 bit IDs and versioning
+	//unsigned int _versionCount = 0;
+
+	static inline uint32_t _nextTypeId();
+
+	template <typename T>
+	static inline uint32_t _storedSize();
+
+	template <typename T>
+	static inline TypeInfo _typeInfo();
+
+	template <typename T>
+	static inline void _constructType(uint8_t* data, uint32_t count);
+
+	template <typename T>
+	static inline void _destroyType(uint8_t* data, uint32_t count);
+
+	template <typename T>
+	static inline void _relocateType(uint8_t* to, uint8_t* from, uint32_t count);
+
+	template <typename T>
+	static inline typename std::enable_if<std::is_copy_constructible<T>::value, void>::type _copyType(uint8_t* to, const uint8_t* from, uint32_t count);
+
+	template <typename T>
+	static inline typename std::enable_if<!std::is_copy_constructible<T>::value, void>::type _copyType(uint8_t* to, const uint8_t* from, uint32_t count);
+
+	static inline void _repeat(uint8_t* data, size_t size, uint32_t count);
+
+	static inline uint32_t _elements(const Archetype& archetype, uint32_t t);
+
+	static inline uint32_t _typeIndex(const Archetype& archetype, uint32_t typeId);
+
+	static inline uint32_t* _chunkTicks(const Archetype& archetype, uint32_t chunkIndex);
+
+	static inline void _construct(const TypeInfo& type, uint8_t* data, uint32_t count);
+
+	static inline void _destroy(const TypeInfo& type, uint8_t* data, uint32_t count);
+
+	static inline void _relocate(const TypeInfo& type, uint8_t* to, uint8_t* from, uint32_t count);
+
+	static inline void _relocateChunks(void* user, uint8_t* to, uint8_t* from, size_t size);
+
+	static inline uint8_t* _tagPointer();
+
+	template <typename T>
+	static inline void _destroyShared(uint8_t* value);
+
+	inline uint8_t* _sharedPointer(const Archetype& archetype, uint32_t typeId);
+
+	template <typename T>
+	static inline uint32_t _typeId();
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I == sizeof...(Args), void>::type _fillFilter(Filter& filter);
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I <sizeof...(Args), void>::type _fillFilter(Filter& filter);
+
+	template <unsigned int I, typename ...Args, typename ...Is>
+	inline typename std::enable_if<I == sizeof...(Args), void>::type _fillMask(Bits& bits, uint32_t* counts, Is... i);
+
+	template <unsigned int I, typename ...Args, typename ...Is>
+	inline typename std::enable_if<I <sizeof...(Args), void>::type _fillMask(Bits& bits, uint32_t* counts, Is... i);
+
+	inline Mask _archetypeMask(uint32_t archetypeIndex);
+
+	inline Mask _getMask(uint32_t id);
+
+	static inline uint64_t _archetypeHash(const Bits& bits, const TypeInfo* infos, const uint32_t* counts, uint32_t infoCount);
+
+	inline bool _sameArchetype(uint32_t archetypeIndex, const Bits& bits, const TypeInfo* infos, const uint32_t* counts, uint32_t infoCount);
+
+	inline void _indexArchetype(uint32_t archetypeIndex);
+
+	inline uint32_t _archetype(const Bits& bits, const TypeInfo* infos, const uint32_t* counts, uint32_t infoCount);
+
+	inline uint32_t _matchArchetypes(const Filter& filter, uint32_t begin, uint32_t* matches);
+
+	inline void _updateQuery(Query& query, const Filter& filter);
+
+	inline uint8_t* _chunkPointer(const Archetype& archetype, uint32_t chunkIndex);
+
+	inline uint8_t* _dataPointer(const Archetype& archetype, uint8_t* chunk, uint32_t index, uint32_t typeId);
+
+	template <typename T>
+	inline T* _blockPointer(const Archetype& archetype, uint8_t* chunk, uint32_t index);
+
+	inline void _constructBlock(uint32_t archetypeIndex, uint32_t blockIndex);
+
+	inline void _destroyBlock(uint32_t archetypeIndex, uint32_t blockIndex);
+
+	inline void _relocateBlock(uint32_t archetypeIndex, uint32_t toIndex, uint32_t fromIndex);
+
+	inline uint32_t _chunkBlocks(const Archetype& archetype, uint32_t chunkIndex);
+
+	inline uint32_t _pushBlock(uint32_t archetypeIndex, uint32_t id);
+
+	inline uint32_t _pushBlocks(uint32_t archetypeIndex, uint32_t count);
+
+	inline void _constructBlocks(uint32_t archetypeIndex, uint32_t first, uint32_t count);
+
+	inline void _cloneBlocks(uint32_t archetypeIndex, uint32_t prototype, uint32_t first, uint32_t count);
+
+	inline uint32_t _newId();
+
+	inline void _assignIds(uint32_t archetypeIndex, uint32_t first, uint32_t count, uint32_t* ids);
+
+	inline void _eraseBlock(uint32_t archetypeIndex, uint32_t blockIndex, bool destroy = true);
+
+	inline void _markBlocks(const Archetype& archetype, uint32_t first, uint32_t count);
+
+	template <typename T>
+	inline void _markBlock(const Archetype& archetype, uint32_t blockIndex);
+
+	inline void _moveTicks(const Archetype& archetype, uint32_t toBlock, uint32_t fromBlock);
+
+	template <typename T>
+	inline uint32_t _transition(uint32_t archetypeIndex, unsigned int count);
+
+	inline void _moveBlock(uint32_t id, uint32_t archetypeIndex);
+
+	template <unsigned int I, typename ...Args>
+	inline typename std::enable_if<I == sizeof...(Args), void>::type _writtenColumns(const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, bool stamp, uint32_t** columns, uint32_t& columnCount);
+
+	template <unsigned int I, typename ...Args>
+	inline typename std::enable_if<I <sizeof...(Args), void>::type _writtenColumns(const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, bool stamp, uint32_t** columns, uint32_t& columnCount);
+
+	template <unsigned int I, typename ...Args>
+	inline typename std::enable_if<I == sizeof...(Args), bool>::type _changedColumns(const Archetype& archetype, uint32_t chunkIndex, const uint32_t** columns, uint32_t& columnCount);
+
+	template <unsigned int I, typename ...Args>
+	inline typename std::enable_if<I <sizeof...(Args), bool>::type _changedColumns(const Archetype& archetype, uint32_t chunkIndex, const uint32_t** columns, uint32_t& columnCount);
+
+	inline bool _changed(const uint32_t* const* columns, uint32_t columnCount, uint32_t index) const;
+
+	inline void _markColumns(uint32_t* const* columns, uint32_t columnCount, uint32_t begin, uint32_t end);
+
+	inline void _publish(const Archetype& archetype, uint32_t t);
+
+	template <typename T, typename ...Args>
+	inline void _executeChunk(const T& lambda, const Mask& mask, std::tuple<Args*...> tuple, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end, bool stamp = true);
+
+	template <typename T, typename ...Args>
+	inline void _executeBatch(const T& lambda, const Mask& mask, std::tuple<Args*...> tuple, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end, bool stamp = true);
+
+	template <typename T>
+	inline void _executeArchetypes(const T& run, const uint32_t* matches, uint32_t matchCount);
+
+	template <typename T>
+	inline void _executeParallel(WorkPool& workers, const T& run, const uint32_t* matches, uint32_t matchCount, uint32_t grain, bool deterministic);
+
+	template <typename T>
+	inline void _executeMatching(const T& run, const Filter& filter);
+
+	template <typename T, typename U>
+	inline bool _executeCursor(Cursor& cursor, const T& lambda, const U& allowance);
+
+	template <typename ...Args>
+	static inline Filter _tupleFilter(const std::tuple<Args*...>& tuple);
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I == sizeof...(Args), void>::type _fillAccess(Access& access);
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I <sizeof...(Args), void>::type _fillAccess(Access& access);
+
+	template <typename T, typename ...Args>
+	static inline Access _lambdaAccess(void(T::*lambda)(const Mask&, Args*...) const);
+
+	template <typename T, typename ...Args>
+	inline std::tuple<Args*...> _lambdaTuple(void(T::*lambda)(const Mask&, Args*...) const);
+
+	template <typename T, typename ...Args>
+	inline std::tuple<Args*...> _lambdaTuple(void(T::*lambda)(const Mask&, uint32_t, const uint32_t*, Args*...) const);
+
+	template <unsigned int I, typename ...Args>
+	inline typename std::enable_if<I == sizeof...(Args), bool>::type _packed(const Mask& mask, const Archetype& archetype);
+
+	template <unsigned int I, typename ...Args>
+	inline typename std::enable_if<I <sizeof...(Args), bool>::type _packed(const Mask& mask, const Archetype& archetype);
+
+	// Pointers to a chunk's first block, with how far to step per block (0 for shared, tags and missing types)
+	template <typename T>
+	inline typename std::enable_if<!Parameter<T>::optional && !Parameter<T>::excluded, T*>::type _parameterPointer(const Mask& mask, const Archetype& archetype, uint8_t* chunk, uint32_t& stride);
+
+	template <typename T>
+	inline typename std::enable_if<Parameter<T>::optional, T*>::type _parameterPointer(const Mask& mask, const Archetype& archetype, uint8_t* chunk, uint32_t& stride);
+
+	template <typename T>
+	inline typename std::enable_if<Parameter<T>::excluded, T*>::type _parameterPointer(const Mask& mask, const Archetype& archetype, uint8_t* chunk, uint32_t& stride);
+
+	template <unsigned int I, typename ...Args>
+	inline typename std::enable_if<I == sizeof...(Args), void>::type _fillTuple(const Mask& mask, std::tuple<Args*...>* tuple, const Archetype& archetype, uint8_t* chunk, uint32_t* strides);
+
+	template <unsigned int I, typename ...Args>
+	inline typename std::enable_if<I <sizeof...(Args), void>::type _fillTuple(const Mask& mask, std::tuple<Args*...>* tuple, const Archetype& archetype, uint8_t* chunk, uint32_t* strides);
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I == sizeof...(Args), void>::type _offsetTuple(std::tuple<Args*...>* tuple, const std::tuple<Args*...>& first, const uint32_t* strides, uint32_t index);
+
+	template <unsigned int I, typename ...Args>
+	static inline typename std::enable_if<I <sizeof...(Args), void>::type _offsetTuple(std::tuple<Args*...>* tuple, const std::tuple<Args*...>& first, const uint32_t* strides, uint32_t index);
+
+	template <typename T, typename ...Args>
+	inline void _callLambda(const T& lambda, const Mask& mask, std::tuple<Args*...>* tuple);
+
+public:
+	inline TypePool(size_t chunkSize, Layout layout = Interleaved);
+	inline ~TypePool();
+
+	inline unsigned int count() const;
+
+	template <typename ...Args, typename ...Is>
+	inline uint32_t insert(Is... i);
+
+	// Many blocks of one layout at once, ids (if given) are filled in order
+	template <typename ...Args, typename ...Is>
+	inline void spawn(uint32_t count, uint32_t* ids, Is... i);
+
+	inline void clone(uint32_t prototypeId, uint32_t count, uint32_t* ids = nullptr);
+
+	// Ends a frame for Changed<T>, and copies T into Previous<T> where T changed
+	inline void tick();
+
+	template <typename T>
+	inline uint32_t share(const T& value);
+
+	template <typename T>
+	inline T* shared(uint32_t handle);
+
+	inline void erase(uint32_t id);
+
+	template <typename T>
+	inline T* addComponent(uint32_t id, unsigned int count = 1);
+
+	template <typename T>
+	inline void removeComponent(uint32_t id);
+	
+	template <typename T>
+	inline unsigned int length(uint32_t id);
+
+	template <typename T>
+	inline T* get(uint32_t id);
+
+	template <typename A, typename B, typename ...Args>
+	inline std::tuple<A*, B*, Args*...> get(uint32_t id);
+
+	template <typename T>
+	inline void execute(const T& lambda);
+
+	template <typename T>
+	inline void execute(Query& query, const T& lambda);
+
+	template <typename T>
+	inline void executeParallel(WorkPool& workers, const T& lambda, uint32_t grain = 0, bool deterministic = false);
+
+	template <typename T>
+	inline void executeParallel(WorkPool& workers, Query& query, const T& lambda, uint32_t grain = 0, bool deterministic = false);
+
+	// Stops after budget blocks (or microseconds), returns true once a whole pass is done
+	template <typename T>
+	inline bool execute(Cursor& cursor, uint32_t budget, const T& lambda);
+
+	template <typename T>
+	inline bool execute(Cursor& cursor, std::chrono::microseconds budget, const T& lambda);
+
+	// Lambdas take (mask, count, ids, pointers to the first of each type) for a run of blocks
+	template <typename T>
+	inline void executeBatch(const T& lambda);
+
+	template <typename T>
+	inline void executeBatch(Query& query, const T& lambda);
+
+	template <typename T>
+	inline void executeBatchParallel(WorkPool& workers, const T& lambda, uint32_t grain = 0, bool deterministic = false);
+
+	template <typename T>
+	static inline Access access(const T& lambda);
+};
+
+void TypePool::Bits::set(uint32_t i, bool value){
+	words[i / 64] = BitHelper::setBit(words[i / 64], i % 64, value);
+}
+
+bool TypePool::Bits::get(uint32_t i) const{
+	return BitHelper::getBit(words[i / 64], i % 64);
+}
+
+bool TypePool::Bits::fits(const Bits& other) const{
+	for (uint32_t i = 0; i < _maskWords; i++){
+		if ((words[i] & other.words[i]) != words[i])
+			return false;
+	}
+
+	return true;
+}
+
+bool TypePool::Bits::intersects(const Bits& other) const{
+	for (uint32_t i = 0; i < _maskWords; i++){
+		if (words[i] & other.words[i])
+			return true;
+	}
+
+	return false;
+}
+
+bool TypePool::Bits::operator==(const Bits& other) const{
+	return !std::memcmp(words, other.words, sizeof(words));
+}
+
+bool TypePool::Filter::matches(const Bits& bits) const{
+	return required.fits(bits) && !excluded.intersects(bits);
+}
+
+bool TypePool::Filter::operator==(const Filter& other) const{
+	return required == other.required && excluded == other.excluded;
+}
+
+template<typename T>
+inline unsigned int TypePool::Mask::length() const{
+	return _counts[_typeId<T>()];
+}
+
+TypePool::Query::Query(Query&& other) noexcept{
+	_filter = other._filter;
+	_matches = other._matches;
+	_matchCount = other._matchCount;
+	_testedCount = other._testedCount;
+
+	other._matches = nullptr;
+	other._matchCount = 0;
+	other._testedCount = 0;
+}
+
+TypePool::Query::~Query(){
+	if (_matches)
+		std::free(_matches);
+}
+
+uint32_t TypePool::Cursor::passes() const{
+	return _passes;
+}
+
+template <typename T>
+inline bool TypePool::Access::reads() const{
+	return _read.get(_typeId<T>());
+}
+
+template <typename T>
+inline bool TypePool::Access::writes() const{
+	return _write.get(_typeId<T>());
+}
+
+inline bool TypePool::Access::conflicts(const Access& other) const{
+	// Reading alongside reading is fine, anything alongside writing isn't
+	return _write.intersects(other._read) || _read.intersects(other._write);
+}
+
+template<typename ...Args>
+inline TypePool::Filter TypePool::_tupleFilter(const std::tuple<Args*...>& tuple){
+	// Initialized once per argument list (thread safe, as executeParallel may run from several threads)
+	static Filter filter = []{
+		Filter filter;
+		_fillFilter<0, Args...>(filter);
+
+		return filter;
+	}();
+
+	return filter;
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_fillAccess(Access& access){}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_fillAccess(Access& access){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+	uint32_t id = _typeId<typename Parameter<T>::Type>();
+
+	// Excluded types and tags have no data to conflict over
+	if (!Parameter<T>::stored && !Parameter<T>::shared){
+		_fillAccess<I + 1, Args...>(access);
+		return;
+	}
+
+	access._read.set(id, true);
+
+	if (!std::is_const<T>::value)
+		access._write.set(id, true);
+
+	_fillAccess<I + 1, Args...>(access);
+}
+
+template <typename T, typename ...Args>
+TypePool::Access TypePool::_lambdaAccess(void(T::*lambda)(const Mask&, Args*...) const){
+	Access access;
+	_fillAccess<0, Args...>(access);
+
+	return access;
+}
+
+template<typename T, typename ...Args>
+std::tuple<Args*...> TypePool::_lambdaTuple(void(T::*lambda)(const Mask&, Args*...) const){
+	return std::tuple<Args*...>();
+}
+
+template<typename T, typename ...Args>
+std::tuple<Args*...> TypePool::_lambdaTuple(void(T::*lambda)(const Mask&, uint32_t, const uint32_t*, Args*...) const){
+	return std::tuple<Args*...>();
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), bool>::type TypePool::_packed(const Mask& mask, const Archetype& archetype){
+	return true;
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), bool>::type TypePool::_packed(const Mask& mask, const Archetype& archetype){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+	using Type = typename Parameter<T>::Type;
+
+	uint32_t id = _typeId<Type>();
+
+	// Types the block doesn't have are passed as nullptr anyway
+	if (Parameter<T>::stored && mask._counts[id] && archetype.strides[id] != sizeof(Type) * mask._counts[id])
+		return false;
+
+	return _packed<I + 1, Args...>(mask, archetype);
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_fillTuple(const Mask& mask, std::tuple<Args*...>* tuple, const Archetype& archetype, uint8_t* chunk, uint32_t* strides){}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_fillTuple(const Mask& mask, std::tuple<Args*...>* tuple, const Archetype& archetype, uint8_t* chunk, uint32_t* strides){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+	std::get<I>(*tuple) = _parameterPointer<T>(mask, archetype, chunk, strides[I]);
+
+	_fillTuple<I + 1>(mask, tuple, archetype, chunk, strides);
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_offsetTuple(std::tuple<Args*...>* tuple, const std::tuple<Args*...>& first, const uint32_t* strides, uint32_t index){}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_offsetTuple(std::tuple<Args*...>* tuple, const std::tuple<Args*...>& first, const uint32_t* strides, uint32_t index){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+	std::get<I>(*tuple) = (T*)((const uint8_t*)std::get<I>(first) + (size_t)index * strides[I]);
+
+	_offsetTuple<I + 1>(tuple, first, strides, index);
+}
+
+template <typename T>
+typename std::enable_if<!TypePool::Parameter<T>::optional && !TypePool::Parameter<T>::excluded, T*>::type TypePool::_parameterPointer(const Mask& mask, const Archetype& archetype, uint8_t* chunk, uint32_t& stride){
+	stride = 0;
+
+	if (Parameter<T>::shared)
+		return (T*)_sharedPointer(archetype, _typeId<typename Parameter<T>::Type>());
+
+	if (!Parameter<T>::stored)
+		return (T*)_tagPointer();
+
+	uint32_t id = _typeId<typename Parameter<T>::Type>();
+	stride = archetype.strides[id];
+
+	return (T*)_dataPointer(archetype, chunk, 0, id);
+}
+
+template <typename T>
+typename std::enable_if<TypePool::Parameter<T>::optional, T*>::type TypePool::_parameterPointer(const Mask& mask, const Archetype& archetype, uint8_t* chunk, uint32_t& stride){
+	uint32_t id = _typeId<typename Parameter<T>::Type>();
+
+	stride = 0;
+
+	if (!mask._counts[id])
+		return nullptr;
+
+	if (Parameter<T>::shared)
+		return (T*)_sharedPointer(archetype, id);
+
+	if (!Parameter<T>::stored)
+		return (T*)_tagPointer();
+
+	stride = archetype.strides[id];
+
+	return (T*)_dataPointer(archetype, chunk, 0, id);
+}
+
+template <typename T>
+typename std::enable_if<TypePool::Parameter<T>::excluded, T*>::type TypePool::_parameterPointer(const Mask& mask, const Archetype& archetype, uint8_t* chunk, uint32_t& stride){
+	stride = 0;
+
+	return nullptr;
+}
+
+template <typename T, typename ...Args>
+void TypePool::_callLambda(const T& lambda, const Mask& mask, std::tuple<Args*...>* tuple){
+	lambda(mask, std::get<Args*>(*tuple)...);
+}
+
+template <typename T>
+uint32_t TypePool::TypeId<T>::value(){
+	// Assigned on first use, a namespace scope static could be read by another static's initializer before it's set
+	static const uint32_t id = _nextTypeId();
+
+	return id;
+}
+
+template <typename T>
+uint32_t TypePool::Buffer<T>::source(){
+	return MAX_TYPES;
+}
+
+template <typename T>
+uint32_t TypePool::Buffer<TypePool::Previous<T>>::source(){
+	return _typeId<T>();
+}
+
+uint32_t TypePool::_nextTypeId(){
+	// Constant initialized (so no guard), atomic as types can first be used from several threads at once
+	static std::atomic<uint32_t> counter(RESERVED_TYPES);
+
+	uint32_t id = counter++;
+
+	assert(id < MAX_TYPES);
+
+	return id;
+}
+
+template <typename T>
+uint32_t TypePool::_storedSize(){
+	return Parameter<T>::stored ? sizeof(T) : 0;
+}
+
+template <typename T>
+TypePool::TypeInfo TypePool::_typeInfo(){
+	TypeInfo info;
+	info.id = _typeId<T>();
+	info.size = _storedSize<T>();
+	info.align = info.size ? alignof(T) : 1;
+
+	// Tags are never constructed, there's nowhere to put them
+	bool stored = info.size != 0;
+
+	info.construct = stored && !std::is_trivially_default_constructible<T>::value ? &_constructType<T> : nullptr;
+	info.destroy = stored && !std::is_trivially_destructible<T>::value ? &_destroyType<T> : nullptr;
+	info.relocate = stored && !std::is_trivially_copyable<T>::value ? &_relocateType<T> : nullptr;
+	info.copy = stored && !std::is_trivially_copyable<T>::value ? &_copyType<T> : nullptr;
+
+	info.source = Buffer<T>::source();
+	info.shared = Parameter<T>::shared;
+
+	return info;
+}
+
+template <typename T>
+void TypePool::_constructType(uint8_t* data, uint32_t count){
+	for (uint32_t i = 0; i < count; i++)
+		new (data + i * sizeof(T)) T();
+}
+
+template <typename T>
+void TypePool::_destroyType(uint8_t* data, uint32_t count){
+	for (uint32_t i = 0; i < count; i++)
+		((T*)(data + i * sizeof(T)))->~T();
+}
+
+template <typename T>
+void TypePool::_relocateType(uint8_t* to, uint8_t* from, uint32_t count){
+	for (uint32_t i = 0; i < count; i++){
+		T* object = (T*)(from + i * sizeof(T));
+
+		new (to + i * sizeof(T)) T(std::move(*object));
+		object->~T();
+	}
+}
+
+template <typename T>
+typename std::enable_if<std::is_copy_constructible<T>::value, void>::type TypePool::_copyType(uint8_t* to, const uint8_t* from, uint32_t count){
+	for (uint32_t i = 0; i < count; i++)
+		new (to + i * sizeof(T)) T(*(const T*)(from + i * sizeof(T)));
+}
+
+template <typename T>
+typename std::enable_if<!std::is_copy_constructible<T>::value, void>::type TypePool::_copyType(uint8_t* to, const uint8_t* from, uint32_t count){
+	// Blocks with types that can't be copied can't be cloned
+	assert(false);
+}
+
+void TypePool::_repeat(uint8_t* data, size_t size, uint32_t count){
+	// The first copy is already there, double what's been filled each time so most of the work is a few large copies
+	size_t filled = size;
+	size_t total = size * count;
+
+	while (filled < total){
+		size_t copy = filled < total - filled ? filled : total - filled;
+
+		std::memcpy(data + filled, data, copy);
+		filled += copy;
+	}
+}
+
+uint32_t TypePool::_elements(const Archetype& archetype, uint32_t t){
+	return archetype.types[t].size ? archetype.sizes[t] / archetype.types[t].size : 0;
+}
+
+uint32_t TypePool::_typeIndex(const Archetype& archetype, uint32_t typeId){
+	uint32_t t = 0;
+
+	while (t < archetype.typeCount && archetype.types[t].id != typeId)
+		t++;
+
+	assert(t < archetype.typeCount);
+
+	return t;
+}
+
+uint32_t* TypePool::_chunkTicks(const Archetype& archetype, uint32_t chunkIndex){
+	return archetype.ticks + chunkIndex * archetype.typeCount * (1 + archetype.blocksPerChunk);
+}
+
+void TypePool::_construct(const TypeInfo& type, uint8_t* data, uint32_t count){
+	if (type.construct)
+		type.construct(data, count);
+	else
+		std::memset(data, 0, type.size * count);
+}
+
+void TypePool::_destroy(const TypeInfo& type, uint8_t* data, uint32_t count){
+	if (type.destroy)
+		type.destroy(data, count);
+}
+
+void TypePool::_relocate(const TypeInfo& type, uint8_t* to, uint8_t* from, uint32_t count){
+	if (type.relocate)
+		type.relocate(to, from, count);
+	else
+		std::memcpy(to, from, type.size * count);
+}
+
+void TypePool::_relocateChunks(void* user, uint8_t* to, uint8_t* from, size_t size){
+	TypePool& pool = *(TypePool*)user;
+
+	// Copy everything, then properly move whatever needs it over the top
+	std::memcpy(to, from, size);
+
+	for (uint32_t a = 0; a < pool._archetypeCount; a++){
+		const Archetype& archetype = pool._archetypes[a];
+
+		if (archetype.trivial || !archetype.blockSize)
+			continue;
+
+		for (uint32_t b = 0; b < archetype.count; b++){
+			uint8_t* toChunk = pool._chunkPointer(archetype, b / archetype.blocksPerChunk);
+			uint8_t* fromChunk = from + (toChunk - to);
+
+			uint32_t index = b % archetype.blocksPerChunk;
+
+			for (uint32_t t = 0; t < archetype.typeCount; t++){
+				const TypeInfo& type = archetype.types[t];
+
+				if (type.relocate)
+					type.relocate(pool._dataPointer(archetype, toChunk, index, type.id), pool._dataPointer(archetype, fromChunk, index, type.id), _elements(archetype, t));
+			}
+		}
+	}
+}
+
+uint8_t* TypePool::_tagPointer(){
+	// Somewhere non-null for tags to point, as there's never anything to read or write
+	static uint8_t tag = 0;
+	return &tag;
+}
+
+template <typename T>
+void TypePool::_destroyShared(uint8_t* value){
+	delete (T*)value;
+}
+
+uint8_t* TypePool::_sharedPointer(const Archetype& archetype, uint32_t typeId){
+	return _shared[typeId].values[archetype.handles[typeId] - 1];
+}
+
+template<typename T>
+uint32_t TypePool::_typeId(){
+	// Const and non-const pointers to a type refer to the same data
+	return TypeId<typename std::remove_const<T>::type>::value();
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_fillFilter(Filter& filter){}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_fillFilter(Filter& filter){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+	uint32_t id = _typeId<typename Parameter<T>::Type>();
+
+	// Optional types don't affect matching at all
+	if (Parameter<T>::excluded)
+		filter.excluded.set(id, true);
+	else if (!Parameter<T>::optional)
+		filter.required.set(id, true);
+
+	_fillFilter<I + 1, Args...>(filter);
+}
+
+template <unsigned int I, typename ...Args, typename ...Is>
+inline typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_fillMask(Bits& bits, uint32_t* counts, Is... i){}
+
+template <unsigned int I, typename ...Args, typename ...Is>
+inline typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_fillMask(Bits& bits, uint32_t* counts, Is... i){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+	uint32_t id = _typeId<T>();
+
+	uint32_t count = (uint32_t)std::get<I>(std::tuple<Is...>(i...));
+
+	// Shared types are given a handle instead of a count, and there's only ever one
+	assert(Parameter<T>::shared ? count <= _shared[id].count : count <= UINT8_MAX);
+
+	// A count of zero means the type isn't there at all
+	counts[I] = count;
+	bits.set(id, count != 0);
+
+	_fillMask<I + 1, Args...>(bits, counts, i...);
+}
+
+inline TypePool::Mask TypePool::_archetypeMask(uint32_t archetypeIndex){
+	Mask mask;
+	mask._bits = _maskBits[archetypeIndex];
+	mask._counts = _maskBuffer + (archetypeIndex * MAX_TYPES);
+
+	return mask;
+}
+
+inline TypePool::Mask TypePool::_getMask(uint32_t id){
+	assert(id < _idCount);
+	return _archetypeMask(BitHelper::front(_ids[id]));
+}
+
+inline uint64_t TypePool::_archetypeHash(const Bits& bits, const TypeInfo* infos, const uint32_t* counts, uint32_t infoCount){
+	uint64_t hash = 14695981039346656037ull;
+
+	for (uint32_t w = 0; w < _maskWords; w++)
+		hash = (hash ^ bits.words[w]) * 1099511628211ull;
+
+	// A count of 1 is implied by the bit, so only other counts and shared handles are mixed in (with xor, as types come in any order)
+	for (uint32_t t = 0; t < infoCount; t++){
+		if (infos[t].shared || counts[t] != 1)
+			hash ^= (((uint64_t)infos[t].id << 32) | counts[t]) * 11400714819323198485ull;
+	}
+
+	return hash ^ (hash >> 32);
+}
+
+inline bool TypePool::_sameArchetype(uint32_t archetypeIndex, const Bits& bits, const TypeInfo* infos, const uint32_t* counts, uint32_t infoCount){
+	if (!(_maskBits[archetypeIndex] == bits))
+		return false;
+
+	// Same types, so only their counts (or handles) can differ
+	const Archetype& archetype = _archetypes[archetypeIndex];
+	const uint8_t* archetypeCounts = _maskBuffer + (archetypeIndex * MAX_TYPES);
+
+	for (uint32_t t = 0; t < infoCount; t++){
+		uint32_t id = infos[t].id;
+
+		if (infos[t].shared ? archetype.handles[id] != counts[t] : archetypeCounts[id] != counts[t])
+			return false;
+	}
+
+	return true;
+}
+
+inline void TypePool::_indexArchetype(uint32_t archetypeIndex){
+	// Kept at most half full, rebuilt from the stored hashes when it grows
+	if ((archetypeIndex + 1) * 2 > _archetypeTableSize){
+		_archetypeTableSize = _archetypeTableSize ? _archetypeTableSize * 2 : 32;
+
+		if (_archetypeTable)
+			std::free(_archetypeTable);
+
+		_archetypeTable = (uint32_t*)std::calloc(_archetypeTableSize, sizeof(uint32_t));
+
+		for (uint32_t i = 0; i < archetypeIndex; i++)
+			_indexArchetype(i);
+	}
+
+	uint32_t slot = (uint32_t)_archetypes[archetypeIndex].hash & (_archetypeTableSize - 1);
+
+	while (_archetypeTable[slot])
+		slot = (slot + 1) & (_archetypeTableSize - 1);
+
+	_archetypeTable[slot] = archetypeIndex + 1;
+}
+
+inline uint32_t TypePool::_archetype(const Bits& bits, const TypeInfo* infos, const uint32_t* counts, uint32_t infoCount){
+	uint64_t hash = _archetypeHash(bits, infos, counts, infoCount);
+
+	// Find archetype with identical mask and shared values
+	for (uint32_t slot = (uint32_t)hash & (_archetypeTableSize - 1); _archetypeTableSize && _archetypeTable[slot]; slot = (slot + 1) & (_archetypeTableSize - 1)){
+		uint32_t i = _archetypeTable[slot] - 1;
+
+		if (_archetypes[i].hash == hash && _sameArchetype(i, bits, infos, counts, infoCount))
+			return i;
+	}
+
+	// Create new archetype and copy mask, growing geometrically
+	if (_archetypeCount == _archetypeCapacity){
+		_archetypeCapacity = _archetypeCapacity ? _archetypeCapacity * 2 : 16;
+
+		_archetypes = (Archetype*)std::realloc(_archetypes, sizeof(Archetype) * _archetypeCapacity);
+		_maskBits = (Bits*)std::realloc(_maskBits, sizeof(Bits) * _archetypeCapacity);
+		_maskBuffer = (uint8_t*)std::realloc(_maskBuffer, MAX_TYPES * _archetypeCapacity);
+	}
+
+	Archetype& archetype = _archetypes[_archetypeCount];
+
+	archetype = Archetype();
+	archetype.hash = hash;
+
+	uint8_t* archetypeCounts = _maskBuffer + (_archetypeCount * MAX_TYPES);
+	std::memset(archetypeCounts, 0, MAX_TYPES);
+
+	// Keep a short list of the types actually present (sorted by id) for per-type work on blocks
+	archetype.types = (TypeInfo*)std::malloc(sizeof(TypeInfo) * (infoCount ? infoCount : 1));
+	archetype.sizes = (uint32_t*)std::malloc(sizeof(uint32_t) * (infoCount ? infoCount : 1));
+
+	for (uint32_t i = 0; i < infoCount; i++){
+		uint32_t id = infos[i].id;
+
+		// Shared types are given a handle instead of a count, and there's only ever one
+		uint32_t count = infos[i].shared ? 1 : counts[i];
+
+		uint32_t t = archetype.typeCount;
+
+		for (; t > 0 && archetype.types[t - 1].id > id; t--){
+			archetype.types[t] = archetype.types[t - 1];
+			archetype.sizes[t] = archetype.sizes[t - 1];
+		}
+
+		archetype.types[t] = infos[i];
+		archetype.sizes[t] = infos[i].size * count;
+		archetype.typeCount++;
+
+		archetypeCounts[id] = (uint8_t)count;
+
+		if (infos[i].shared)
+			archetype.handles[id] = counts[i];
+
+		if (infos[i].construct || infos[i].destroy || infos[i].relocate)
+			archetype.trivial = false;
+	}
+
+	// Growing the ChunkPool has to move these properly, rather than by realloc
+	if (!archetype.trivial)
+		_pool.relocator(&_relocateChunks, this);
+
+	// Lay types out largest alignment first, sizes are always a multiple of alignment so nothing needs padding between them
+	uint32_t order[MAX_TYPES];
+	uint32_t maxAlign = 1;
+
+	for (uint32_t t = 0; t < archetype.typeCount; t++){
+		uint32_t j = t;
+
+		for (; j > 0 && archetype.types[order[j - 1]].align < archetype.types[t].align; j--)
+			order[j] = order[j - 1];
+
+		order[j] = t;
+
+		if (archetype.types[t].align > maxAlign)
+			maxAlign = archetype.types[t].align;
+	}
+
+	assert(maxAlign <= CHUNK_ALIGNMENT);
+
+	size_t blockSize = 0;
+
+	for (uint32_t t = 0; t < archetype.typeCount; t++)
+		blockSize += archetype.sizes[t];
+
+	// Interleaved blocks follow each other, so round up to keep the next block aligned too
+	if (_layout == Interleaved)
+		blockSize = (blockSize + maxAlign - 1) / maxAlign * maxAlign;
+
+	assert(blockSize <= _chunkSize);
+
+	archetype.blockSize = blockSize;
+
+	// Empty blocks take no memory, so only group them for the sake of iteration
+	archetype.blocksPerChunk = blockSize ? (uint32_t)(_chunkSize / blockSize) : (uint32_t)_chunkSize;
+
+	// Work out offsets once, columns are laid out in the same order as types in an interleaved block, each one blocks per chunk long
+	size_t offset = 0;
+
+	for (uint32_t o = 0; o < archetype.typeCount; o++){
+		uint32_t t = order[o];
+		uint32_t i = archetype.types[t].id;
+
+		if (_layout == Columns){
+			archetype.starts[i] = (uint32_t)(offset * archetype.blocksPerChunk);
+			archetype.strides[i] = archetype.sizes[t];
+		}
+		else{
+			archetype.starts[i] = (uint32_t)offset;
+			archetype.strides[i] = (uint32_t)blockSize;
+		}
+
+		offset += archetype.sizes[t];
+	}
+
+	_maskBits[_archetypeCount] = bits;
+
+	_indexArchetype(_archetypeCount);
+
+	_archetypeCount++;
+
+	return _archetypeCount - 1;
+}
+
+inline uint32_t TypePool::_matchArchetypes(const Filter& filter, uint32_t begin, uint32_t* matches){
+	// Only words with some of the query's types in them need testing
+	uint32_t words[_maskWords];
+	uint32_t wordCount = 0;
+
+	for (uint32_t w = 0; w < _maskWords; w++){
+		if (filter.required.words[w] | filter.excluded.words[w])
+			words[wordCount++] = w;
+	}
+
+	uint32_t count = 0;
+
+	// Branchless scan over the packed bit masks, so mixed matches don't cost mispredictions
+	for (uint32_t i = begin; i < _archetypeCount; i++){
+		bool fits = true;
+
+		for (uint32_t w = 0; w < wordCount; w++){
+			uint64_t bits = _maskBits[i].words[words[w]];
+
+			fits &= (bits & filter.required.words[words[w]]) == filter.required.words[words[w]];
+			fits &= !(bits & filter.excluded.words[words[w]]);
+		}
+
+		matches[count] = i;
+		count += fits;
+	}
+
+	return count;
+}
+
+inline void TypePool::_updateQuery(Query& query, const Filter& filter){
+	// A query is tied to the lambda signature it was first used with
+	assert(!query._testedCount || query._filter == filter);
+
+	query._filter = filter;
+
+	// Archetypes are never removed, so only new ones need testing
+	if (query._testedCount == _archetypeCount)
+		return;
+
+	query._matches = (uint32_t*)std::realloc(query._matches, sizeof(uint32_t) * _archetypeCount);
+	query._matchCount += _matchArchetypes(filter, query._testedCount, query._matches + query._matchCount);
+	query._testedCount = _archetypeCount;
+}
+
+inline uint8_t* TypePool::_chunkPointer(const Archetype& archetype, uint32_t chunkIndex){
+	if (!archetype.blockSize)
+		return nullptr;
+
+	return _pool.get(archetype.chunks[chunkIndex]);
+}
+
+inline uint8_t* TypePool::_dataPointer(const Archetype& archetype, uint8_t* chunk, uint32_t index, uint32_t typeId){
+	return chunk + archetype.starts[typeId] + (index * archetype.strides[typeId]);
+}
+
+template <typename T>
+inline T* TypePool::_blockPointer(const Archetype& archetype, uint8_t* chunk, uint32_t index){
+	if (Parameter<T>::shared)
+		return (T*)_sharedPointer(archetype, _typeId<T>());
+
+	if (std::is_empty<T>::value)
+		return (T*)_tagPointer();
+
+	return (T*)_dataPointer(archetype, chunk, index, _typeId<T>());
+}
+
+inline void TypePool::_constructBlock(uint32_t archetypeIndex, uint32_t blockIndex){
+	const Archetype& archetype = _archetypes[archetypeIndex];
+
+	uint8_t* chunk = _chunkPointer(archetype, blockIndex / archetype.blocksPerChunk);
+	uint32_t index = blockIndex % archetype.blocksPerChunk;
+
+	if (!chunk)
+		return;
+
+	if (_layout == Interleaved && archetype.trivial){
+		std::memset(chunk + index * archetype.blockSize, 0, archetype.blockSize);
+		return;
+	}
+
+	for (uint32_t t = 0; t < archetype.typeCount; t++)
+		_construct(archetype.types[t], _dataPointer(archetype, chunk, index, archetype.types[t].id), _elements(archetype, t));
+}
+
+inline void TypePool::_destroyBlock(uint32_t archetypeIndex, uint32_t blockIndex){
+	const Archetype& archetype = _archetypes[archetypeIndex];
+
+	if (archetype.trivial)
+		return;
+
+	uint8_t* chunk = _chunkPointer(archetype, blockIndex / archetype.blocksPerChunk);
+	uint32_t index = blockIndex % archetype.blocksPerChunk;
+
+	for (uint32_t t = 0; t < archetype.typeCount; t++)
+		_destroy(archetype.types[t], _dataPointer(archetype, chunk, index, archetype.types[t].id), _elements(archetype, t));
+}
+
+inline void TypePool::_relocateBlock(uint32_t archetypeIndex, uint32_t toIndex, uint32_t fromIndex){
+	const Archetype& archetype = _archetypes[archetypeIndex];
+
+	uint8_t* toChunk = _chunkPointer(archetype, toIndex / archetype.blocksPerChunk);
+	uint8_t* fromChunk = _chunkPointer(archetype, fromIndex / archetype.blocksPerChunk);
+
+	toIndex %= archetype.blocksPerChunk;
+	fromIndex %= archetype.blocksPerChunk;
+
+	if (!toChunk)
+		return;
+
+	if (_layout == Interleaved && archetype.trivial){
+		std::memcpy(toChunk + toIndex * archetype.blockSize, fromChunk + fromIndex * archetype.blockSize, archetype.blockSize);
+		return;
+	}
+
+	for (uint32_t t = 0; t < archetype.typeCount; t++){
+		uint32_t i = archetype.types[t].id;
+		_relocate(archetype.types[t], _dataPointer(archetype, toChunk, toIndex, i), _dataPointer(archetype, fromChunk, fromIndex, i), _elements(archetype, t));
+	}
+}
+
+inline uint32_t TypePool::_chunkBlocks(const Archetype& archetype, uint32_t chunkIndex){
+	uint32_t count = archetype.count - chunkIndex * archetype.blocksPerChunk;
+
+	return count < archetype.blocksPerChunk ? count : archetype.blocksPerChunk;
+}
+
+inline uint32_t TypePool::_pushBlock(uint32_t archetypeIndex, uint32_t id){
+	uint32_t blockIndex = _pushBlocks(archetypeIndex, 1);
+
+	_archetypes[archetypeIndex].ids[blockIndex] = id;
+
+	return blockIndex;
+}
+
+inline uint32_t TypePool::_pushBlocks(uint32_t archetypeIndex, uint32_t count){
+	Archetype& archetype = _archetypes[archetypeIndex];
+
+	// Take as many whole ChunkPool chunks as the new blocks need all at once
+	uint32_t chunkCount = (archetype.count + count + archetype.blocksPerChunk - 1) / archetype.blocksPerChunk;
+
+	if (chunkCount > archetype.chunkCount){
+		archetype.chunks = (uint32_t*)std::realloc(archetype.chunks, sizeof(uint32_t) * chunkCount);
+		archetype.ids = (uint32_t*)std::realloc(archetype.ids, sizeof(uint32_t) * chunkCount * archetype.blocksPerChunk);
+
+		if (archetype.blockSize)
+			archetype.ticks = (uint32_t*)std::realloc(archetype.ticks, sizeof(uint32_t) * chunkCount * archetype.typeCount * (1 + archetype.blocksPerChunk));
+
+		for (; archetype.chunkCount < chunkCount; archetype.chunkCount++){
+			if (archetype.blockSize)
+				archetype.chunks[archetype.chunkCount] = _pool.insert(_chunkSize);
+		}
+	}
+
+	uint32_t first = archetype.count;
+
+	archetype.count += count;
+
+	// New blocks count as changed, including blocks moved here by adding or removing a type
+	_markBlocks(archetype, first, count);
+
+	// Left unconstructed, it's up to the caller to fill them
+	return first;
+}
+
+inline void TypePool::_constructBlocks(uint32_t archetypeIndex, uint32_t first, uint32_t count){
+	const Archetype& archetype = _archetypes[archetypeIndex];
+
+	if (!archetype.blockSize)
+		return;
+
+	// A run at a time within each chunk
+	for (uint32_t b = first; b < first + count;){
+		uint32_t index = b % archetype.blocksPerChunk;
+		uint32_t run = archetype.blocksPerChunk - index < first + count - b ? archetype.blocksPerChunk - index : first + count - b;
+
+		uint8_t* chunk = _chunkPointer(archetype, b / archetype.blocksPerChunk);
+
+		if (_layout == Interleaved && archetype.trivial){
+			std::memset(chunk + index * archetype.blockSize, 0, run * archetype.blockSize);
+		}
+		else if (_layout == Columns){
+			for (uint32_t t = 0; t < archetype.typeCount; t++)
+				_construct(archetype.types[t], _dataPointer(archetype, chunk, index, archetype.types[t].id), _elements(archetype, t) * run);
+		}
+		else{
+			for (uint32_t i = 0; i < run; i++)
+				_constructBlock(archetypeIndex, b + i);
+		}
+
+		b += run;
+	}
+}
+
+inline void TypePool::_cloneBlocks(uint32_t archetypeIndex, uint32_t prototype, uint32_t first, uint32_t count){
+	const Archetype& archetype = _archetypes[archetypeIndex];
+
+	if (!archetype.blockSize)
+		return;
+
+	uint8_t* prototypeChunk = _chunkPointer(archetype, prototype / archetype.blocksPerChunk);
+	uint32_t prototypeIndex = prototype % archetype.blocksPerChunk;
+
+	for (uint32_t b = first; b < first + count;){
+		uint32_t index = b % archetype.blocksPerChunk;
+		uint32_t run = archetype.blocksPerChunk - index < first + count - b ? archetype.blocksPerChunk - index : first + count - b;
+
+		uint8_t* chunk = _chunkPointer(archetype, b / archetype.blocksPerChunk);
+
+		if (_layout == Interleaved && archetype.trivial){
+			// Whole blocks are contiguous, so copy the prototype once and repeat it
+			uint8_t* data = chunk + index * archetype.blockSize;
+
+			std::memcpy(data, prototypeChunk + prototypeIndex * archetype.blockSize, archetype.blockSize);
+			_repeat(data, archetype.blockSize, run);
+		}
+		else{
+			for (uint32_t t = 0; t < archetype.typeCount; t++){
+				const TypeInfo& type = archetype.types[t];
+
+				uint8_t* from = _dataPointer(archetype, prototypeChunk, prototypeIndex, type.id);
+
+				if (type.copy){
+					for (uint32_t i = 0; i < run; i++)
+						type.copy(_dataPointer(archetype, chunk, index + i, type.id), from, _elements(archetype, t));
+				}
+				else if (_layout == Columns){
+					// Each column is contiguous, so the same applies per type
+					uint8_t* data = _dataPointer(archetype, chunk, index, type.id);
+
+					std::memcpy(data, from, archetype.sizes[t]);
+					_repeat(data, archetype.sizes[t], run);
+				}
+				else{
+					for (uint32_t i = 0; i < run; i++)
+						std::memcpy(_dataPointer(archetype, chunk, index + i, type.id), from, archetype.sizes[t]);
+				}
+			}
+		}
+
+		b += run;
+	}
+}
+
+inline uint32_t TypePool::_newId(){
+	if (!_freeIds.empty()){
+		uint32_t id = _freeIds.top();
+		_freeIds.pop();
+
+		return id;
+	}
+
+	// Grow geometrically rather than an id at a time
+	if (_idCount == _idCapacity){
+		_idCapacity = _idCapacity ? _idCapacity * 2 : 64;
+		_ids = (uint64_t*)std::realloc(_ids, sizeof(uint64_t) * _idCapacity);
+	}
+
+	return _idCount++;
+}
+
+inline void TypePool::_assignIds(uint32_t archetypeIndex, uint32_t first, uint32_t count, uint32_t* ids){
+	for (uint32_t i = 0; i < count; i++){
+		uint32_t id = _newId();
+
+		_archetypes[archetypeIndex].ids[first + i] = id;
+		_ids[id] = BitHelper::combine(archetypeIndex, first + i);
+
+		if (ids)
+			ids[i] = id;
+	}
+}
+
+inline void TypePool::_eraseBlock(uint32_t archetypeIndex, uint32_t blockIndex, bool destroy){
+	Archetype& archetype = _archetypes[archetypeIndex];
+
+	assert(blockIndex < archetype.count);
+
+	// Not when the block's data has already been moved somewhere else
+	if (destroy)
+		_destroyBlock(archetypeIndex, blockIndex);
+
+	// Move last block into the gap and update its id
+	uint32_t lastIndex = archetype.count - 1;
+
+	if (blockIndex != lastIndex){
+		_relocateBlock(archetypeIndex, blockIndex, lastIndex);
+		_moveTicks(archetype, blockIndex, lastIndex);
+
+		uint32_t lastId = archetype.ids[lastIndex];
+
+		archetype.ids[blockIndex] = lastId;
+		_ids[lastId] = BitHelper::combine(archetypeIndex, blockIndex);
+	}
+
+	archetype.count--;
+
+	// Give back the last chunk once it's empty
+	if (archetype.count == (archetype.chunkCount - 1) * archetype.blocksPerChunk){
+		archetype.chunkCount--;
+
+		if (archetype.blockSize)
+			_pool.erase(archetype.chunks[archetype.chunkCount]);
+	}
+}
+
+inline void TypePool::_markBlocks(const Archetype& archetype, uint32_t first, uint32_t count){
+	if (!archetype.ticks)
+		return;
+
+	for (uint32_t b = first; b < first + count;){
+		uint32_t index = b % archetype.blocksPerChunk;
+		uint32_t run = archetype.blocksPerChunk - index < first + count - b ? archetype.blocksPerChunk - index : first + count - b;
+
+		uint32_t* ticks = _chunkTicks(archetype, b / archetype.blocksPerChunk);
+
+		for (uint32_t t = 0; t < archetype.typeCount; t++){
+			uint32_t* column = ticks + archetype.typeCount + t * archetype.blocksPerChunk;
+
+			ticks[t] = _tick;
+			std::fill(column + index, column + index + run, _tick);
+		}
+
+		b += run;
+	}
+}
+
+template <typename T>
+inline void TypePool::_markBlock(const Archetype& archetype, uint32_t blockIndex){
+	// Only handing out a non-const pointer counts as a change
+	if (std::is_const<T>::value || !Parameter<T>::stored)
+		return;
+
+	uint32_t t = _typeIndex(archetype, _typeId<T>());
+	uint32_t* ticks = _chunkTicks(archetype, blockIndex / archetype.blocksPerChunk);
+
+	ticks[t] = _tick;
+	ticks[archetype.typeCount + t * archetype.blocksPerChunk + blockIndex % archetype.blocksPerChunk] = _tick;
+}
+
+inline void TypePool::_moveTicks(const Archetype& archetype, uint32_t toBlock, uint32_t fromBlock){
+	if (!archetype.ticks)
+		return;
+
+	uint32_t* toTicks = _chunkTicks(archetype, toBlock / archetype.blocksPerChunk);
+	uint32_t* fromTicks = _chunkTicks(archetype, fromBlock / archetype.blocksPerChunk);
+
+	// A block keeps its ticks when moved, and the chunk it lands in has changed no earlier than it has
+	for (uint32_t t = 0; t < archetype.typeCount; t++){
+		uint32_t tick = fromTicks[archetype.typeCount + t * archetype.blocksPerChunk + fromBlock % archetype.blocksPerChunk];
+
+		toTicks[archetype.typeCount + t * archetype.blocksPerChunk + toBlock % archetype.blocksPerChunk] = tick;
+
+		if (tick > toTicks[t])
+			toTicks[t] = tick;
+	}
+}
+
+template <typename T>
+inline uint32_t TypePool::_transition(uint32_t archetypeIndex, unsigned int count){
+	uint32_t typeId = _typeId<T>();
+
+	// For shared types the count is a handle
+	assert(Parameter<T>::shared ? count <= _shared[typeId].count : count <= UINT8_MAX);
+
+	const Archetype& archetype = _archetypes[archetypeIndex];
+
+	for (uint32_t e = 0; e < archetype.edgeCount; e++){
+		if (archetype.edges[e].type == typeId && archetype.edges[e].count == count)
+			return archetype.edges[e].archetypeIndex;
+	}
+
+	// Same mask with one count changed
+	Bits bits = _maskBits[archetypeIndex];
+	bits.set(typeId, count != 0);
+
+	// The existing types, leaving out the one being changed (counts are handles for shared types)
+	const uint8_t* archetypeCounts = _maskBuffer + (archetypeIndex * MAX_TYPES);
+
+	TypeInfo infos[MAX_TYPES];
+	uint32_t counts[MAX_TYPES];
+	uint32_t infoCount = 0;
+
+	for (uint32_t t = 0; t < archetype.typeCount; t++){
+		uint32_t id = archetype.types[t].id;
+
+		if (id == typeId)
+			continue;
+
+		infos[infoCount] = archetype.types[t];
+		counts[infoCount++] = archetype.types[t].shared ? archetype.handles[id] : archetypeCounts[id];
+	}
+
+	if (count){
+		infos[infoCount] = _typeInfo<T>();
+		counts[infoCount++] = count;
+	}
+
+	uint32_t target = _archetype(bits, infos, counts, infoCount);
+
+	// Archetypes may have moved when a new one was made
+	Archetype& source = _archetypes[archetypeIndex];
+
+	source.edges = (Edge*)std::realloc(source.edges, sizeof(Edge) * (source.edgeCount + 1));
+	source.edges[source.edgeCount] = { typeId, count, target };
+	source.edgeCount++;
+
+	return target;
+}
+
+inline void TypePool::_moveBlock(uint32_t id, uint32_t archetypeIndex){
+	uint64_t pair = _ids[id];
+
+	uint32_t fromIndex = BitHelper::front(pair);
+	uint32_t fromBlock = BitHelper::back(pair);
+
+	if (fromIndex == archetypeIndex)
+		return;
+
+	uint32_t toBlock = _pushBlock(archetypeIndex, id);
+
+	const Archetype& from = _archetypes[fromIndex];
+	const Archetype& to = _archetypes[archetypeIndex];
+
+	uint8_t* fromChunk = _chunkPointer(from, fromBlock / from.blocksPerChunk);
+	uint8_t* toChunk = _chunkPointer(to, toBlock / to.blocksPerChunk);
+
+	uint32_t fromIndexInChunk = fromBlock % from.blocksPerChunk;
+	uint32_t toIndexInChunk = toBlock % to.blocksPerChunk;
+
+	// Both type lists are sorted, so walk them together moving whatever both have (as much as fits if a count changed)
+	uint32_t f = 0;
+
+	for (uint32_t t = 0; t < to.typeCount; t++){
+		const TypeInfo& type = to.types[t];
+
+		uint8_t* toData = _dataPointer(to, toChunk, toIndexInChunk, type.id);
+		uint32_t toCount = _elements(to, t);
+
+		// Types being removed
+		for (; f < from.typeCount && from.types[f].id < type.id; f++)
+			_destroy(from.types[f], _dataPointer(from, fromChunk, fromIndexInChunk, from.types[f].id), _elements(from, f));
+
+		if (f == from.typeCount || from.types[f].id != type.id){
+			_construct(type, toData, toCount);
+			continue;
+		}
+
+		uint8_t* fromData = _dataPointer(from, fromChunk, fromIndexInChunk, type.id);
+		uint32_t fromCount = _elements(from, f);
+
+		uint32_t moved = fromCount < toCount ? fromCount : toCount;
+
+		_relocate(type, toData, fromData, moved);
+		_construct(type, toData + moved * type.size, toCount - moved);
+		_destroy(type, fromData + moved * type.size, fromCount - moved);
+
+		f++;
+	}
+
+	for (; f < from.typeCount; f++)
+		_destroy(from.types[f], _dataPointer(from, fromChunk, fromIndexInChunk, from.types[f].id), _elements(from, f));
+
+	_eraseBlock(fromIndex, fromBlock, false);
+
+	_ids[id] = BitHelper::combine(archetypeIndex, toBlock);
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_writtenColumns(const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, bool stamp, uint32_t** columns, uint32_t& columnCount){}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_writtenColumns(const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, bool stamp, uint32_t** columns, uint32_t& columnCount){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
+	uint32_t id = _typeId<typename Parameter<T>::Type>();
+
+	// Blocks passed as Changed<T> are already stamped with this tick
+	if (!std::is_const<T>::value && Parameter<T>::stored && !Parameter<T>::changed && mask._counts[id]){
+		uint32_t t = _typeIndex(archetype, id);
+		uint32_t* ticks = _chunkTicks(archetype, chunkIndex);
+
+		// Left to one range when a chunk is split across workers, so they never write the same tick
+		if (stamp)
+			ticks[t] = _tick;
+
+		columns[columnCount++] = ticks + archetype.typeCount + t * archetype.blocksPerChunk;
+	}
+
+	_writtenColumns<I + 1, Args...>(mask, archetype, chunkIndex, stamp, columns, columnCount);
+}
+
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I == sizeof...(Args), bool>::type TypePool::_changedColumns(const Archetype& archetype, uint32_t chunkIndex, const uint32_t** columns, uint32_t& columnCount){
+	return true;
+}
 
-/*
-pool.insert<Banana, Dog, Puzzle>(1, 1, 1);				// Will iterate over (arguments are how many of each type)
-pool.insert<Banana, Dog, Wizard, Puzzle>(1, 1, 1, 5);	// Will iterate over (5 of Puzzle for array example)
-pool.insert<Banana, Dog>(1, 1, 1);						// Will NOT iterate over (doesn't contain Puzzle)
+template <unsigned int I, typename ...Args>
+typename std::enable_if<I < sizeof...(Args), bool>::type TypePool::_changedColumns(const Archetype& archetype, uint32_t chunkIndex, const uint32_t** columns, uint32_t& columnCount){
+	using T = std::tuple_element_t<I, std::tuple<Args...>>;
 
-pool.execute([](const TypePool::Mask& mask, Banana* banana, Dog* dog, Puzzle* puzzle){   // Data types provided as pointers in the lambda arguments (mask is a required arg for pool lambdas)	
-	
-	// Do stuff here
-	
-	for (unsigned int i = 0; i < mask.length<Puzzle(); i++){
-		puzzle[i];		// Array example
+	if (Parameter<T>::changed){
+		uint32_t t = _typeIndex(archetype, _typeId<typename Parameter<T>::Type>());
+		const uint32_t* ticks = _chunkTicks(archetype, chunkIndex);
+
+		// Nothing in the chunk changed, so no block in it can have
+		if (ticks[t] < _tick)
+			return false;
+
+		columns[columnCount++] = ticks + archetype.typeCount + t * archetype.blocksPerChunk;
 	}
 
-	return;
-});
-*/
+	return _changedColumns<I + 1, Args...>(archetype, chunkIndex, columns, columnCount);
+}
 
-class TypePool{
-public:
-	class Mask{
-		uint8_t* _start = nullptr;
+bool TypePool::_changed(const uint32_t* const* columns, uint32_t columnCount, uint32_t index) const{
+	for (uint32_t c = 0; c < columnCount; c++){
+		if (columns[c][index] < _tick)
+			return false;
+	}
 
-		inline bool _fits(const Mask& other);
+	return true;
+}
 
-	public:		
-		template <typename T>
-		inline unsigned int length() const;
+void TypePool::_markColumns(uint32_t* const* columns, uint32_t columnCount, uint32_t begin, uint32_t end){
+	for (uint32_t c = 0; c < columnCount; c++)
+		std::fill(columns[c] + begin, columns[c] + end, _tick);
+}
 
-		friend class TypePool;
-	};
+template <typename T, typename ...Args>
+void TypePool::_executeChunk(const T& lambda, const Mask& mask, std::tuple<Args*...> tuple, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end, bool stamp){
+	const uint32_t* changed[sizeof...(Args) + 1];
+	uint32_t changedCount = 0;
 
-private:
-	ChunkPool _pool;
+	if (Tracked<Args...>::value && !_changedColumns<0, Args...>(archetype, chunkIndex, changed, changedCount))
+		return;
 
-	uint8_t* _maskBuffer = nullptr;
-	uint32_t _maskCount = 0;
-	
-	//uint32_t* _versions = nullptr; // TODO: Reintegrate 64 bit IDs and versioning
-	//unsigned int _versionCount = 0;
+	uint8_t* chunk = Stored<Args...>::value ? _chunkPointer(archetype, chunkIndex) : nullptr;
 
-	static uint32_t _typeCounter;
+	// Written types are stamped for every block handed to the lambda
+	uint32_t* written[sizeof...(Args) + 1] = {};
+	uint32_t writtenCount = 0;
 
-	static size_t* _typeSizes;
+	_writtenColumns<0, Args...>(mask, archetype, chunkIndex, stamp, written, writtenCount);
 
-	template <typename T>
-	static inline uint32_t _typeId();
+	if (!Tracked<Args...>::value)
+		_markColumns(written, writtenCount, begin, end);
 
-	template <unsigned int I, typename ...Args>
-	inline typename std::enable_if<I == sizeof...(Args), void>::type _fillMask(const Mask& mask);
+	// Ids, starts and strides are looked up once per chunk, blocks only step along from the first
+	std::tuple<Args*...> first;
+	uint32_t strides[sizeof...(Args) + 1];
 
-	template <unsigned int I, typename ...Args>
-	inline typename std::enable_if<I <sizeof...(Args), void>::type _fillMask(const Mask& mask);
+	_fillTuple<0>(mask, &first, archetype, chunk, strides);
 
-	template <unsigned int I, typename ...Args, typename ...Is>
-	inline typename std::enable_if<I == sizeof...(Args), void>::type _fillMask(const Mask& mask, Is... i);
+	for (uint32_t i = begin; i < end; i++){
+		if (Tracked<Args...>::value){
+			if (!_changed(changed, changedCount, i))
+				continue;
 
-	template <unsigned int I, typename ...Args, typename ...Is>
-	inline typename std::enable_if<I <sizeof...(Args), void>::type _fillMask(const Mask& mask, Is... i);
+			_markColumns(written, writtenCount, i, i + 1);
+		}
 
-	inline void _clearMask(const Mask& mask);
+		_offsetTuple<0>(&tuple, first, strides, i);
+		_callLambda(lambda, mask, &tuple);
+	}
+}
 
-	inline Mask _getMask(uint32_t id);
+template <typename T, typename ...Args>
+void TypePool::_executeBatch(const T& lambda, const Mask& mask, std::tuple<Args*...> tuple, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end, bool stamp){
+	const uint32_t* changed[sizeof...(Args) + 1];
+	uint32_t changedCount = 0;
 
-	template <typename ...Args>
-	inline Mask _tupleMask(const std::tuple<Args*...>& tuple);
+	if (Tracked<Args...>::value && !_changedColumns<0, Args...>(archetype, chunkIndex, changed, changedCount))
+		return;
 
-	template <typename T, typename ...Args>
-	inline std::tuple<Args*...> _lambdaTuple(void(T::*lambda)(const Mask&, Args*...) const);
+	uint8_t* chunk = Stored<Args...>::value ? _chunkPointer(archetype, chunkIndex) : nullptr;
+	const uint32_t* ids = archetype.ids + chunkIndex * archetype.blocksPerChunk;
 
-	template <unsigned int I, typename ...Args>
-	inline typename std::enable_if<I == sizeof...(Args), void>::type _fillTuple(const Mask& mask, std::tuple<Args*...>* tuple, uint8_t* data);
+	uint32_t* written[sizeof...(Args) + 1] = {};
+	uint32_t writtenCount = 0;
 
-	template <unsigned int I, typename ...Args>
-	inline typename std::enable_if<I <sizeof...(Args), void>::type _fillTuple(const Mask& mask, std::tuple<Args*...>* tuple, uint8_t* data);
+	_writtenColumns<0, Args...>(mask, archetype, chunkIndex, stamp, written, writtenCount);
 
-	template <typename T, typename ...Args>
-	inline void _callLambda(const T& lambda, const Mask& mask, std::tuple<Args*...>* tuple);
+	// A whole range at once where every type is contiguous in the chunk (always with Columns), otherwise a block at a time
+	bool packed = _packed<0, Args...>(mask, archetype);
 
-	template <unsigned int I, typename ...Args>
-	inline typename std::enable_if<I == sizeof...(Args), size_t>::type _sizeOf();
+	std::tuple<Args*...> first;
+	uint32_t strides[sizeof...(Args) + 1];
 
-	template <unsigned int I, typename ...Args>
-	inline typename std::enable_if<I <sizeof...(Args), size_t>::type _sizeOf();
+	_fillTuple<0>(mask, &first, archetype, chunk, strides);
 
-	template <unsigned int I, typename ...Args, typename ...Is>
-	inline typename std::enable_if<I == sizeof...(Args), size_t>::type _sizeOf(Is... i);
+	for (uint32_t i = begin; i < end;){
+		uint32_t step = packed ? end - i : 1;
 
-	template <unsigned int I, typename ...Args, typename ...Is>
-	inline typename std::enable_if<I <sizeof...(Args), size_t>::type _sizeOf(Is... i);
-	
-	template <typename T>
-	inline size_t _typeOffset(const Mask& mask);
+		// Runs stop short of unchanged blocks
+		if (Tracked<Args...>::value){
+			if (!_changed(changed, changedCount, i)){
+				i++;
+				continue;
+			}
 
-public:
-	inline TypePool(size_t chunkSize);
-	inline ~TypePool();
+			step = 1;
 
-	template <typename ...Args, typename ...Is>
-	inline uint32_t insert(Is... i);
+			while (packed && i + step < end && _changed(changed, changedCount, i + step))
+				step++;
+		}
 
-	inline void erase(uint32_t id);
-	
-	template <typename T>
-	inline unsigned int length(uint32_t id);
+		_markColumns(written, writtenCount, i, i + step);
 
-	template <typename T>
-	inline T* get(uint32_t id);
+		_offsetTuple<0>(&tuple, first, strides, i);
+		lambda(mask, step, ids + i, std::get<Args*>(tuple)...);
 
-	template <typename T>
-	inline void execute(const T& lambda);
-};
+		i += step;
+	}
+}
+
+template <typename T>
+void TypePool::_executeArchetypes(const T& run, const uint32_t* matches, uint32_t matchCount){
+	for (uint32_t m = 0; m < matchCount; m++){
+		Mask mask = _archetypeMask(matches[m]);
+		const Archetype& archetype = _archetypes[matches[m]];
+
+		for (uint32_t c = 0; c < archetype.chunkCount; c++)
+			run(mask, archetype, c, 0, _chunkBlocks(archetype, c));
+	}
+}
 
-inline bool TypePool::Mask::_fits(const Mask& other){
-	bool fits = true;
+template <typename T>
+void TypePool::_executeMatching(const T& run, const Filter& filter){
+	// Test each archetype once, then stream through its chunks
+	for (uint32_t a = 0; a < _archetypeCount; a++){
+		if (filter.matches(_maskBits[a]))
+			_executeArchetypes(run, &a, 1);
+	}
+}
+
+template <typename T, typename U>
+bool TypePool::_executeCursor(Cursor& cursor, const T& lambda, const U& allowance){
+	auto tuple = _lambdaTuple(&T::operator());
+
+	_updateQuery(cursor._query, _tupleFilter(tuple));
+
+	// Each archetype is walked back to front a run at a time, so erasing only ever moves a block already visited (or the last one) into a gap
+	while (cursor._match < cursor._query._matchCount){
+		uint32_t archetypeIndex = cursor._query._matches[cursor._match];
+
+		Mask mask = _archetypeMask(archetypeIndex);
+		const Archetype& archetype = _archetypes[archetypeIndex];
+
+		// Erased blocks may have left fewer than were still to go
+		if (cursor._block > archetype.count)
+			cursor._block = archetype.count;
 
-	for (unsigned int i = 0; i < MAX_TYPES; i++){
-		if (_start[i] && !other._start[i]){
-			fits = false;
-			break;
+		while (cursor._block){
+			uint32_t chunkIndex = (cursor._block - 1) / archetype.blocksPerChunk;
+			uint32_t end = cursor._block - chunkIndex * archetype.blocksPerChunk;
+
+			uint32_t count = allowance(end);
+
+			if (!count)
+				return false;
+
+			_executeChunk(lambda, mask, tuple, archetype, chunkIndex, end - count, end);
+
+			cursor._block -= count;
 		}
+
+		cursor._match++;
+		cursor._block = UINT32_MAX;
 	}
 
-	return fits;
+	// Start over next time
+	cursor._match = 0;
+	cursor._passes++;
+
+	return true;
 }
 
-template<typename T>
-inline unsigned int TypePool::Mask::length() const{
-	return _start[_typeId<T>()];
+template <typename T>
+void TypePool::_executeParallel(WorkPool& workers, const T& run, const uint32_t* matches, uint32_t matchCount, uint32_t grain, bool deterministic){
+	// Split matching archetypes' chunks into ranges of grain size (or whole chunks if zero)
+	uint32_t rangeCount = 0;
+
+	for (uint32_t m = 0; m < matchCount; m++){
+		const Archetype& archetype = _archetypes[matches[m]];
+
+		for (uint32_t c = 0; c < archetype.chunkCount; c++){
+			uint32_t count = _chunkBlocks(archetype, c);
+
+			rangeCount += grain ? (count + grain - 1) / grain : 1;
+		}
+	}
+
+	if (!rangeCount)
+		return;
+
+	Range* ranges = (Range*)std::malloc(sizeof(Range) * rangeCount);
+	uint32_t rangeIndex = 0;
+
+	for (uint32_t m = 0; m < matchCount; m++){
+		const Archetype& archetype = _archetypes[matches[m]];
+
+		for (uint32_t c = 0; c < archetype.chunkCount; c++){
+			uint32_t count = _chunkBlocks(archetype, c);
+			uint32_t step = grain ? grain : count;
+
+			for (uint32_t begin = 0; begin < count; begin += step){
+				Range& range = ranges[rangeIndex++];
+
+				range.archetypeIndex = matches[m];
+				range.chunkIndex = c;
+				range.begin = begin;
+				range.end = begin + step < count ? begin + step : count;
+			}
+		}
+	}
+
+	workers.run(rangeCount, [&](uint32_t task){
+		const Range& range = ranges[task];
+
+		run(_archetypeMask(range.archetypeIndex), _archetypes[range.archetypeIndex], range.chunkIndex, range.begin, range.end);
+	}, deterministic);
+
+	std::free(ranges);
 }
 
-template<typename ...Args>
-inline TypePool::Mask TypePool::_tupleMask(const std::tuple<Args*...>& tuple){
-	static Mask mask;
+TypePool::TypePool(size_t chunkSize, Layout layout) : _chunkSize(chunkSize), _layout(layout), _pool(chunkSize){}
+
+TypePool::~TypePool(){
+	for (uint32_t i = 0; i < _archetypeCount; i++){
+		for (uint32_t b = 0; b < _archetypes[i].count; b++)
+			_destroyBlock(i, b);
+
+		if (_archetypes[i].chunks)
+			std::free(_archetypes[i].chunks);
+
+		if (_archetypes[i].ids)
+			std::free(_archetypes[i].ids);
+
+		if (_archetypes[i].types)
+			std::free(_archetypes[i].types);
+
+		if (_archetypes[i].sizes)
+			std::free(_archetypes[i].sizes);
+
+		if (_archetypes[i].edges)
+			std::free(_archetypes[i].edges);
 
-	if (!mask._start){
-		mask._start = (uint8_t*)std::calloc(1, MAX_TYPES); 
-		_fillMask<0, Args...>(mask);
+		if (_archetypes[i].ticks)
+			std::free(_archetypes[i].ticks);
 	}
 
-	return mask;
+	if (_archetypes)
+		std::free(_archetypes);
+
+	for (uint32_t i = 0; i < MAX_TYPES; i++){
+		for (uint32_t v = 0; v < _shared[i].count; v++)
+			_shared[i].destroy(_shared[i].values[v]);
+
+		if (_shared[i].values)
+			std::free(_shared[i].values);
+	}
+
+	if (_maskBits)
+		std::free(_maskBits);
+
+	if (_maskBuffer)
+		std::free(_maskBuffer);
+
+	if (_archetypeTable)
+		std::free(_archetypeTable);
+
+	if (_ids)
+		std::free(_ids);
+
+	// TODO: Reintegrate versioning
+	//if (_versions)
+	//	std::free(_versions);
 }
 
-template<typename T, typename ...Args>
-std::tuple<Args*...> TypePool::_lambdaTuple(void(T::*lambda)(const Mask&, Args*...) const){
-	return std::tuple<Args*...>();
+unsigned int TypePool::count() const{
+	unsigned int count = 0;
+
+	for (uint32_t i = 0; i < _archetypeCount; i++)
+		count += _archetypes[i].count;
+
+	return count;
 }
 
-template <unsigned int I, typename ...Args>
-typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_fillTuple(const Mask& mask, std::tuple<Args*...>* tuple, uint8_t* data){}
+template <typename ...Args, typename ...Is>
+inline uint32_t TypePool::insert(Is... i){
+	uint32_t id;
 
-template <unsigned int I, typename ...Args>
-typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_fillTuple(const Mask& mask, std::tuple<Args*...>* tuple, uint8_t* data){
-	using T = std::tuple_element_t<I, std::tuple<Args...>>;
-	std::get<I>(*tuple) = (T*)(data + _typeOffset<T>(mask));
+	spawn<Args...>(1, &id, i...);
 
-	_fillTuple<I + 1>(mask, tuple, data);
+	return id;
 }
 
-template <typename T, typename ...Args>
-void TypePool::_callLambda(const T& lambda, const Mask& mask, std::tuple<Args*...>* tuple){
-	lambda(mask, std::get<Args*>(*tuple)...);
+template <typename ...Args, typename ...Is>
+inline void TypePool::spawn(uint32_t count, uint32_t* ids, Is... i){
+	// Find archetype from mask, once for the whole batch (one extra element so an empty list still compiles)
+	Bits bits;
+	uint32_t counts[sizeof...(Args) + 1];
+
+	_fillMask<0, Args...>(bits, counts, i...);
+
+	// Sizes and alignments are compile time constants, ids are looked up once per batch
+	TypeInfo infos[sizeof...(Args) + 1] = { _typeInfo<Args>()... };
+	uint32_t infoCount = 0;
+
+	// Types given a count of zero are left out
+	for (uint32_t t = 0; t < sizeof...(Args); t++){
+		if (!counts[t])
+			continue;
+
+		infos[infoCount] = infos[t];
+		counts[infoCount++] = counts[t];
+	}
+
+	uint32_t archetypeIndex = _archetype(bits, infos, counts, infoCount);
+
+	uint32_t first = _pushBlocks(archetypeIndex, count);
+
+	_constructBlocks(archetypeIndex, first, count);
+	_assignIds(archetypeIndex, first, count, ids);
 }
 
-template<unsigned int I, typename ...Args>
-typename std::enable_if<I == sizeof...(Args), size_t>::type TypePool::_sizeOf(){
-	return 0;
+void TypePool::clone(uint32_t prototypeId, uint32_t count, uint32_t* ids){
+	assert(prototypeId < _idCount);
+
+	uint32_t archetypeIndex = BitHelper::front(_ids[prototypeId]);
+	uint32_t first = _pushBlocks(archetypeIndex, count);
+
+	// Looked up after pushing, as new chunks can move existing ones
+	_cloneBlocks(archetypeIndex, BitHelper::back(_ids[prototypeId]), first, count);
+	_assignIds(archetypeIndex, first, count, ids);
 }
 
-template <unsigned int I, typename ...Args>
-typename std::enable_if < I <sizeof...(Args), size_t>::type TypePool::_sizeOf(){
-	using T = std::tuple_element_t<I, std::tuple<Args...>>;
-	return sizeof(T) + _sizeOf<I + 1, Args...>();
+template <typename T>
+uint32_t TypePool::share(const T& value){
+	SharedValues& shared = _shared[_typeId<Shared<T>>()];
+
+	// Each value gets its own allocation, so pointers to it stay put
+	shared.values = (uint8_t**)std::realloc(shared.values, sizeof(uint8_t*) * (shared.count + 1));
+	shared.values[shared.count] = (uint8_t*)new T(value);
+	shared.destroy = &_destroyShared<T>;
+	shared.count++;
+
+	// Zero means no value, same as a count of zero
+	return shared.count;
 }
 
-template <unsigned int I, typename ...Args, typename ...Is>
-inline typename std::enable_if<I == sizeof...(Args), size_t>::type TypePool::_sizeOf(Is... i){
-	return 0;
+template <typename T>
+T* TypePool::shared(uint32_t handle){
+	const SharedValues& shared = _shared[_typeId<Shared<T>>()];
+
+	assert(handle && handle <= shared.count);
+
+	return (T*)shared.values[handle - 1];
 }
 
-template <unsigned int I, typename ...Args, typename ...Is>
-inline typename std::enable_if < I < sizeof...(Args), size_t>::type TypePool::_sizeOf(Is... i){
-	using T = std::tuple_element_t<I, std::tuple<Args...>>;
-	return (sizeof(T) * std::get<I>(std::tuple<Is...>(i...))) + _sizeOf<I + 1, Args...>(i...);
+inline void TypePool::_publish(const Archetype& archetype, uint32_t t){
+	const TypeInfo& type = archetype.types[t];
+
+	// Previous<T> on its own has nothing to copy from
+	uint32_t s = 0;
+
+	while (s < archetype.typeCount && archetype.types[s].id != type.source)
+		s++;
+
+	if (s == archetype.typeCount)
+		return;
+
+	uint32_t elements = _elements(archetype, t) < _elements(archetype, s) ? _elements(archetype, t) : _elements(archetype, s);
+
+	for (uint32_t c = 0; c < archetype.chunkCount; c++){
+		// Chunks where T hasn't changed since the last copy already match
+		if (_chunkTicks(archetype, c)[s] < _tick)
+			continue;
+
+		uint8_t* chunk = _chunkPointer(archetype, c);
+		uint32_t blocks = _chunkBlocks(archetype, c);
+
+		if (_layout == Columns && archetype.sizes[t] == archetype.sizes[s]){
+			std::memcpy(_dataPointer(archetype, chunk, 0, type.id), _dataPointer(archetype, chunk, 0, type.source), blocks * archetype.sizes[t]);
+			continue;
+		}
+
+		for (uint32_t b = 0; b < blocks; b++)
+			std::memcpy(_dataPointer(archetype, chunk, b, type.id), _dataPointer(archetype, chunk, b, type.source), elements * type.size);
+	}
 }
 
-template<typename T>
-inline size_t TypePool::_typeOffset(const Mask& mask){
-	size_t offset = 0;
+void TypePool::tick(){
+	// Double buffered types take this frame's values before the frame ends
+	for (uint32_t a = 0; a < _archetypeCount; a++){
+		const Archetype& archetype = _archetypes[a];
 
-	for (unsigned int i = 0; i < _typeId<T>(); i++){
-		offset += _typeSizes[i] * mask._start[i];
+		for (uint32_t t = 0; t < archetype.typeCount; t++){
+			if (archetype.types[t].source != MAX_TYPES && archetype.types[t].size)
+				_publish(archetype, t);
+		}
 	}
 
-	return offset;
+	_tick++;
 }
 
-uint32_t TypePool::_typeCounter = 0;
-
-size_t* TypePool::_typeSizes = nullptr;
+void TypePool::erase(uint32_t id){
+	assert(id < _idCount);
 
-template<typename T>
-uint32_t TypePool::_typeId(){
-	static uint32_t i = _typeCounter++;
+	uint64_t pair = _ids[id];
 
-	assert(_typeCounter < MAX_TYPES);
+	_eraseBlock(BitHelper::front(pair), BitHelper::back(pair));
 
-	if (!_typeSizes)
-		_typeSizes = (size_t*)std::malloc(sizeof(size_t) * MAX_TYPES);
+	_freeIds.push(id);
+}
 
-	static bool first = true;
+template <typename T>
+inline T* TypePool::addComponent(uint32_t id, unsigned int count){
+	assert(id < _idCount);
+	assert(count);
 
-	if (first){
-		first = false;
-		_typeSizes[i] = sizeof(T);
-	}
+	_moveBlock(id, _transition<T>(BitHelper::front(_ids[id]), count));
 
-	return i;
+	return get<T>(id);
 }
 
-template <unsigned int I, typename ...Args>
-typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_fillMask(const Mask& mask){}
+template <typename T>
+inline void TypePool::removeComponent(uint32_t id){
+	assert(id < _idCount);
 
-template <unsigned int I, typename ...Args>
-typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_fillMask(const Mask& mask){
-	using T = std::tuple_element_t<I, std::tuple<Args...>>;
-	mask._start[_typeId<T>()] = 1;
+	_moveBlock(id, _transition<T>(BitHelper::front(_ids[id]), 0));
+}
 
-	_fillMask<I + 1, Args...>(mask);
+template<typename T>
+inline unsigned int TypePool::length(uint32_t id){
+	return _getMask(id)._counts[_typeId<T>()];
 }
 
-template <unsigned int I, typename ...Args, typename ...Is>
-inline typename std::enable_if<I == sizeof...(Args), void>::type TypePool::_fillMask(const Mask& mask, Is... i){}
+template<typename T>
+inline T* TypePool::get(uint32_t id){
+	assert(id < _idCount);
 
-template <unsigned int I, typename ...Args, typename ...Is>
-inline typename std::enable_if<I < sizeof...(Args), void>::type TypePool::_fillMask(const Mask& mask, Is... i){
-	using T = std::tuple_element_t<I, std::tuple<Args...>>;
-	mask._start[_typeId<T>()] = std::get<I>(std::tuple<Is...>(i...));
+	if (std::is_empty<T>::value)
+		return (T*)_tagPointer();
+
+	uint64_t pair = _ids[id];
+
+	uint32_t archetypeIndex = BitHelper::front(pair);
+	uint32_t blockIndex = BitHelper::back(pair);
 
-	_fillMask<I + 1, Args...>(mask, i...);
+	const Archetype& archetype = _archetypes[archetypeIndex];
+
+	uint8_t* chunk = _chunkPointer(archetype, blockIndex / archetype.blocksPerChunk);
+
+	_markBlock<T>(archetype, blockIndex);
+
+	return _blockPointer<T>(archetype, chunk, blockIndex % archetype.blocksPerChunk);
 }
 
-inline void TypePool::_clearMask(const Mask& mask){
-	std::memset(mask._start, 0, MAX_TYPES);
+template <typename A, typename B, typename ...Args>
+inline std::tuple<A*, B*, Args*...> TypePool::get(uint32_t id){
+	assert(id < _idCount);
+
+	// Resolve the id and chunk once, then each type is just its offset
+	uint64_t pair = _ids[id];
+
+	uint32_t archetypeIndex = BitHelper::front(pair);
+	uint32_t blockIndex = BitHelper::back(pair);
+
+	const Archetype& archetype = _archetypes[archetypeIndex];
+
+	uint8_t* chunk = _chunkPointer(archetype, blockIndex / archetype.blocksPerChunk);
+	uint32_t index = blockIndex % archetype.blocksPerChunk;
+
+	int marked[] = { (_markBlock<A>(archetype, blockIndex), 0), (_markBlock<B>(archetype, blockIndex), 0), (_markBlock<Args>(archetype, blockIndex), 0)... };
+	(void)marked;
+
+	return std::tuple<A*, B*, Args*...>(_blockPointer<A>(archetype, chunk, index), _blockPointer<B>(archetype, chunk, index), _blockPointer<Args>(archetype, chunk, index)...);
 }
 
-inline TypePool::Mask TypePool::_getMask(uint32_t id){
-	if (id >= _maskCount){
-		_maskCount = id + 1;
+template<typename T>
+void TypePool::execute(const T& lambda){
+	auto tuple = _lambdaTuple(&T::operator());
 
-		if (!_maskBuffer)
-			_maskBuffer = (uint8_t*)std::malloc(_maskCount * MAX_TYPES);
-		else
-			_maskBuffer = (uint8_t*)std::realloc(_maskBuffer, _maskCount * MAX_TYPES);
-	}
+	_executeMatching([&](const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end){
+		_executeChunk(lambda, mask, tuple, archetype, chunkIndex, begin, end);
+	}, _tupleFilter(tuple));
+}
 
-	Mask mask;
-	mask._start = _maskBuffer + (id * MAX_TYPES);
+template<typename T>
+void TypePool::execute(Query& query, const T& lambda){
+	auto tuple = _lambdaTuple(&T::operator());
 
-	return mask;
+	_updateQuery(query, _tupleFilter(tuple));
+
+	_executeArchetypes([&](const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end){
+		_executeChunk(lambda, mask, tuple, archetype, chunkIndex, begin, end);
+	}, query._matches, query._matchCount);
 }
 
-TypePool::TypePool(size_t chunkSize) : _pool(chunkSize){}
+template<typename T>
+void TypePool::executeParallel(WorkPool& workers, const T& lambda, uint32_t grain, bool deterministic){
+	auto tuple = _lambdaTuple(&T::operator());
+	Filter filter = _tupleFilter(tuple);
 
-TypePool::~TypePool(){
-	if (_maskBuffer)
-		std::free(_maskBuffer);
+	static_assert(!SharedWrite<decltype(tuple)>::value, "Shared types can only be read in parallel");
 
-	// TODO: Reintegrate versioning
-	//if (_versions)
-	//	std::free(_versions);
+	if (!_archetypeCount)
+		return;
+
+	// Find all matching archetypes in one pass over the masks
+	uint32_t* matches = (uint32_t*)std::malloc(sizeof(uint32_t) * _archetypeCount);
+	uint32_t matchCount = _matchArchetypes(filter, 0, matches);
+
+	// Every range of a chunk runs in this call, so the one starting it stamps the chunk for all of them
+	_executeParallel(workers, [&](const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end){
+		_executeChunk(lambda, mask, tuple, archetype, chunkIndex, begin, end, begin == 0);
+	}, matches, matchCount, grain, deterministic);
+
+	std::free(matches);
 }
 
-template <typename ...Args, typename ...Is>
-inline uint32_t TypePool::insert(Is... i){
-	uint32_t id = _pool.insert(_sizeOf<0, Args...>(i...));
+template<typename T>
+void TypePool::executeParallel(WorkPool& workers, Query& query, const T& lambda, uint32_t grain, bool deterministic){
+	auto tuple = _lambdaTuple(&T::operator());
 
-	Mask mask = _getMask(id);
+	static_assert(!SharedWrite<decltype(tuple)>::value, "Shared types can only be read in parallel");
 
-	_clearMask(mask);
-	_fillMask<0, Args...>(mask, i...);
+	_updateQuery(query, _tupleFilter(tuple));
 
-	return id;
+	// Every range of a chunk runs in this call, so the one starting it stamps the chunk for all of them
+	_executeParallel(workers, [&](const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end){
+		_executeChunk(lambda, mask, tuple, archetype, chunkIndex, begin, end, begin == 0);
+	}, query._matches, query._matchCount, grain, deterministic);
 }
 
-void TypePool::erase(uint32_t id){
-	_clearMask(_getMask(id));
-	_pool.erase(id);
+template<typename T>
+bool TypePool::execute(Cursor& cursor, uint32_t budget, const T& lambda){
+	return _executeCursor(cursor, lambda, [&](uint32_t wanted){
+		uint32_t count = wanted < budget ? wanted : budget;
+
+		budget -= count;
+		return count;
+	});
 }
 
 template<typename T>
-inline unsigned int TypePool::length(uint32_t id){
-	return _getMask(id)._start[_typeId<T>()];
+bool TypePool::execute(Cursor& cursor, std::chrono::microseconds budget, const T& lambda){
+	auto start = std::chrono::steady_clock::now();
+	bool started = false;
+
+	// Runs are kept short so the clock is checked often, and there's always some progress
+	return _executeCursor(cursor, lambda, [&](uint32_t wanted){
+		if (started && std::chrono::steady_clock::now() - start >= budget)
+			return 0u;
+
+		started = true;
+		return wanted < 64 ? wanted : 64u;
+	});
 }
 
 template<typename T>
-inline T* TypePool::get(uint32_t id){
-	return (T*)(_pool.get(id) + _typeOffset<T>(_getMask(id)));
+void TypePool::executeBatch(const T& lambda){
+	auto tuple = _lambdaTuple(&T::operator());
+
+	_executeMatching([&](const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end){
+		_executeBatch(lambda, mask, tuple, archetype, chunkIndex, begin, end);
+	}, _tupleFilter(tuple));
 }
 
 template<typename T>
-void TypePool::execute(const T& lambda){
+void TypePool::executeBatch(Query& query, const T& lambda){
 	auto tuple = _lambdaTuple(&T::operator());
-	Mask tupleMask = _tupleMask(tuple);
 
-	ChunkPool::Iterator iter = _pool.begin();
+	_updateQuery(query, _tupleFilter(tuple));
 
-	while (iter.valid()){
-		Mask iterMask = _getMask(iter.id());
+	_executeArchetypes([&](const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end){
+		_executeBatch(lambda, mask, tuple, archetype, chunkIndex, begin, end);
+	}, query._matches, query._matchCount);
+}
 
-		if (tupleMask._fits(iterMask)){
-			_fillTuple<0>(iterMask, &tuple, iter.get());
-			_callLambda(lambda, iterMask, &tuple);
-		}
+template<typename T>
+void TypePool::executeBatchParallel(WorkPool& workers, const T& lambda, uint32_t grain, bool deterministic){
+	auto tuple = _lambdaTuple(&T::operator());
+	Filter filter = _tupleFilter(tuple);
 
-		iter.next();
-	}
+	static_assert(!SharedWrite<decltype(tuple)>::value, "Shared types can only be read in parallel");
+
+	if (!_archetypeCount)
+		return;
+
+	uint32_t* matches = (uint32_t*)std::malloc(sizeof(uint32_t) * _archetypeCount);
+	uint32_t matchCount = _matchArchetypes(filter, 0, matches);
+
+	// Every range of a chunk runs in this call, so the one starting it stamps the chunk for all of them
+	_executeParallel(workers, [&](const Mask& mask, const Archetype& archetype, uint32_t chunkIndex, uint32_t begin, uint32_t end){
+		_executeBatch(lambda, mask, tuple, archetype, chunkIndex, begin, end, begin == 0);
+	}, matches, matchCount, grain, deterministic);
+
+	std::free(matches);
+}
+
+template<typename T>
+TypePool::Access TypePool::access(const T& lambda){
+	return _lambdaAccess(&T::operator());
 }
\ No newline at end of file
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <cstdint>
+#include <cassert>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// WorkPool: A fixed set of worker threads for running batches of indexed tasks in parallel.
+// Each batch is split into one contiguous range of task indices per worker, workers take tasks from the front of their own range, and when empty steal the back half of another worker's range.
+// With deterministic set no stealing happens, so every task is always run by the same worker in the same order (given the same task count and worker count).
+// The calling thread acts as worker 0, and run() returns once every task in the batch has finished.
+// Batches started from several threads at once are queued one after another.
+
+class WorkPool{
+	struct Range{
+		std::mutex mutex;
+
+		uint32_t begin = 0;
+		uint32_t end = 0;
+	};
+
+	template <typename T>
+	static inline void _invoke(const void* task, uint32_t index);
+
+	std::thread* _threads = nullptr;
+	Range* _ranges = nullptr;
+
+	const unsigned int _workerCount;
+
+	std::mutex _batch;
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _done;
+
+	uint64_t _generation = 0;
+	unsigned int _running = 0;
+	bool _stopping = false;
+
+	const void* _task = nullptr;
+	void(*_call)(const void*, uint32_t) = nullptr;
+	bool _deterministic = false;
+
+	static inline unsigned int& _current();
+
+	inline bool _take(unsigned int worker, uint32_t& index);
+
+	inline bool _steal(unsigned int worker, uint32_t& index);
+
+	inline void _work(unsigned int worker);
+
+	inline void _loop(unsigned int worker);
+
+public:
+	inline WorkPool(unsigned int workers = std::thread::hardware_concurrency());
+	inline ~WorkPool();
+
+	inline unsigned int workers() const;
+
+	template <typename T>
+	inline void run(uint32_t count, const T& task, bool deterministic = false);
+
+	static inline unsigned int worker();
+};
+
+template <typename T>
+void WorkPool::_invoke(const void* task, uint32_t index){
+	(*(const T*)task)(index);
+}
+
+unsigned int& WorkPool::_current(){
+	static thread_local unsigned int worker = 0;
+	return worker;
+}
+
+bool WorkPool::_take(unsigned int worker, uint32_t& index){
+	Range& range = _ranges[worker];
+
+	std::lock_guard<std::mutex> lock(range.mutex);
+
+	if (range.begin == range.end)
+		return false;
+
+	index = range.begin;
+	range.begin++;
+
+	return true;
+}
+
+bool WorkPool::_steal(unsigned int worker, uint32_t& index){
+	for (unsigned int i = 1; i < _workerCount; i++){
+		Range& victim = _ranges[(worker + i) % _workerCount];
+
+		uint32_t begin;
+		uint32_t end;
+
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+
+			if (victim.begin == victim.end)
+				continue;
+
+			// Take the back half (rounded up) so the victim keeps working from the front
+			begin = victim.begin + (victim.end - victim.begin) / 2;
+			end = victim.end;
+
+			victim.end = begin;
+		}
+
+		// Run the first stolen task and keep the rest in our own range for others to steal from
+		Range& range = _ranges[worker];
+
+		std::lock_guard<std::mutex> lock(range.mutex);
+
+		range.begin = begin + 1;
+		range.end = end;
+
+		index = begin;
+		return true;
+	}
+
+	return false;
+}
+
+void WorkPool::_work(unsigned int worker){
+	uint32_t index;
+
+	for (;;){
+		if (!_take(worker, index) && (_deterministic || !_steal(worker, index)))
+			break;
+
+		_call(_task, index);
+	}
+}
+
+void WorkPool::_loop(unsigned int worker){
+	_current() = worker;
+
+	uint64_t generation = 0;
+
+	for (;;){
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [&]{ return _stopping || _generation != generation; });
+
+			if (_stopping)
+				return;
+
+			generation = _generation;
+		}
+
+		_work(worker);
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running--;
+		}
+
+		_done.notify_one();
+	}
+}
+
+WorkPool::WorkPool(unsigned int workers) : _workerCount(workers ? workers : 1){
+	_ranges = new Range[_workerCount];
+
+	if (_workerCount > 1){
+		_threads = new std::thread[_workerCount - 1];
+
+		for (unsigned int i = 1; i < _workerCount; i++)
+			_threads[i - 1] = std::thread(&WorkPool::_loop, this, i);
+	}
+}
+
+WorkPool::~WorkPool(){
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+
+	_wake.notify_all();
+
+	if (_threads){
+		for (unsigned int i = 0; i < _workerCount - 1; i++)
+			_threads[i].join();
+
+		delete[] _threads;
+	}
+
+	delete[] _ranges;
+}
+
+unsigned int WorkPool::workers() const{
+	return _workerCount;
+}
+
+template <typename T>
+void WorkPool::run(uint32_t count, const T& task, bool deterministic){
+	if (!count)
+		return;
+
+	// Batches aren't re-entrant, tasks must not call run() on the same pool (it would deadlock here)
+	std::lock_guard<std::mutex> batch(_batch);
+
+	// Split tasks into contiguous ranges, one per worker
+	for (unsigned int i = 0; i < _workerCount; i++){
+		_ranges[i].begin = (uint32_t)(((uint64_t)count * i) / _workerCount);
+		_ranges[i].end = (uint32_t)(((uint64_t)count * (i + 1)) / _workerCount);
+	}
+
+	_task = &task;
+	_call = &_invoke<T>;
+	_deterministic = deterministic;
+
+	// Wake workers and join in as worker 0
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = _workerCount - 1;
+		_generation++;
+	}
+
+	_wake.notify_all();
+
+	unsigned int previous = _current();
+	_current() = 0;
+
+	_work(0);
+
+	_current() = previous;
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [&]{ return _running == 0; });
+	}
+
+	_task = nullptr;
+	_call = nullptr;
+}
+
+unsigned int WorkPool::worker(){
+	return _current();
+}
\ No newline at end of file
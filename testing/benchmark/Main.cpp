@@ -0,0 +1,85 @@
+#include <ChunkPool.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+// Measures per-frame update time of every block in a ChunkPool, serially with an Iterator and in parallel with parallelForEach from 1 to N worker threads.
+
+#define CHUNK 32 * 1024
+#define BLOCKS 1000000
+#define FRAMES 20
+
+struct Body{
+	float position[3];
+	float velocity[3];
+	float mass;
+};
+
+inline void update(Body* body){
+	for (unsigned int i = 0; i < 3; i++){
+		body->velocity[i] -= body->velocity[i] * 0.01f / body->mass;
+		body->position[i] += std::sqrt(body->velocity[i] * body->velocity[i] + 1.f) * 0.016f;
+	}
+}
+
+template <typename T>
+double measure(const T& frame){
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int i = 0; i < FRAMES; i++)
+		frame();
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	return elapsed.count() / FRAMES;
+}
+
+int main(int argc, char *argv[]){
+	ChunkPool pool(CHUNK);
+
+	for (unsigned int i = 0; i < BLOCKS; i++){
+		Body* body = (Body*)pool.get(pool.insert(sizeof(Body)));
+
+		body->velocity[0] = (float)(rand() % 100);
+		body->mass = 1.f + (float)(rand() % 10);
+	}
+
+	double serial = measure([&]{
+		ChunkPool::Iterator iter = pool.begin();
+
+		while (iter.valid()){
+			update((Body*)iter.get());
+			iter.next();
+		}
+	});
+
+	std::cout << "Blocks:\t\t" << BLOCKS << "\n";
+	std::cout << "Serial:\t\t" << serial << " ms\n\n";
+
+	unsigned int maxThreads = std::thread::hardware_concurrency();
+
+	if (argc > 1)
+		maxThreads = (unsigned int)std::atoi(argv[1]);
+
+	// Powers of two below maxThreads, then maxThreads itself
+	for (unsigned int threads = 1; threads <= maxThreads; threads = threads < maxThreads && threads * 2 > maxThreads ? maxThreads : threads * 2){
+		WorkPool workers(threads);
+
+		for (bool deterministic : { false, true }){
+			double parallel = measure([&]{
+				pool.parallelForEach(workers, [](uint32_t, uint8_t* data){
+					update((Body*)data);
+				}, 0, deterministic);
+			});
+
+			std::cout << "Threads:\t" << threads << (deterministic ? " (deterministic)" : "") << "\n";
+			std::cout << "Frame:\t\t" << parallel << " ms\n";
+			std::cout << "Speedup:\t" << serial / parallel << "x\n\n";
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "ChunkPool.hpp"
 
 #include <gtest\gtest.h>
+#include <algorithm>
+#include <atomic>
 #include <list>
 #include <vector>
 #include <tuple>
@@ -76,4 +78,224 @@ TEST(ChunkPoolTest, InsertErase){
 	for (auto& pair : added){
 		EXPECT_TRUE(pair.second == (*(TestObject*)pool.get(pair.first)));
 	}
+}
+
+TEST(ChunkPoolTest, IterateAfterErase){
+	ChunkPool pool(CHUNK);
+
+	std::vector<bool> alive(BLOCKS, true);
+
+	for (unsigned int i = 0; i < BLOCKS; i++)
+		pool.insert(sizeof(TestObject));
+
+	for (unsigned int i = 0; i < BLOCKS; i++){
+		if (!(rand() % 3)){
+			pool.erase(i);
+			alive[i] = false;
+		}
+	}
+
+	std::vector<unsigned int> visited(BLOCKS, 0);
+
+	ChunkPool::Iterator iter = pool.begin();
+
+	while (iter.valid()){
+		visited[iter.id()]++;
+		iter.next();
+	}
+
+	for (unsigned int i = 0; i < BLOCKS; i++)
+		EXPECT_EQ(alive[i] ? 1u : 0u, visited[i]);
+}
+
+TEST(ChunkPoolTest, ParallelForEach){
+	ChunkPool pool(CHUNK);
+	WorkPool workers(4);
+
+	for (unsigned int i = 0; i < BLOCKS; i++){
+		uint32_t id = pool.insert(sizeof(TestObject));
+		(*(TestObject*)pool.get(id)) = TestObject(id, id, id);
+	}
+
+	for (unsigned int i = 0; i < BLOCKS; i += 7)
+		pool.erase(i);
+
+	for (uint32_t grain : { 0u, 1u, 64u }){
+		for (bool deterministic : { false, true }){
+			std::vector<std::atomic<unsigned int>> visited(BLOCKS);
+
+			for (auto& count : visited)
+				count = 0;
+
+			pool.parallelForEach(workers, [&](uint32_t id, uint8_t* data){
+				EXPECT_EQ(id, ((TestObject*)data)->x);
+				visited[id]++;
+			}, grain, deterministic);
+
+			for (unsigned int i = 0; i < BLOCKS; i++)
+				EXPECT_EQ(i % 7 ? 1u : 0u, visited[i].load());
+		}
+	}
+}
+
+TEST(ChunkPoolTest, ChunkAlignment){
+	// Chunk sizes that aren't a multiple of the alignment still start every chunk aligned
+	ChunkPool pool(1000);
+
+	for (unsigned int i = 0; i < 50; i++){
+		uint32_t id = pool.insert(1000);
+
+		EXPECT_EQ(0u, (uintptr_t)pool.get(id) % CHUNK_ALIGNMENT);
+		std::memset(pool.get(id), i, 1000);
+	}
+
+	for (unsigned int i = 0; i < 50; i++)
+		EXPECT_EQ((uint8_t)i, pool.get(i)[999]);
+}
+
+TEST(ChunkPoolTest, EraseDuringIteration){
+	ChunkPool pool(4 * 1024);
+
+	std::vector<bool> alive(2000, true);
+
+	// Mixed sizes, each block filled with its own id
+	for (unsigned int i = 0; i < 2000; i++){
+		uint32_t id = pool.insert(sizeof(uint32_t) * (1 + i % 4));
+
+		for (unsigned int j = 0; j < 1 + i % 4; j++)
+			((uint32_t*)pool.get(id))[j] = id;
+	}
+
+	// Erase as we go, the returned iterator carries on from the next block
+	ChunkPool::Iterator iter = pool.begin();
+	unsigned int visited = 0;
+
+	while (iter.valid()){
+		visited++;
+
+		if (iter.id() % 3 == 0){
+			alive[iter.id()] = false;
+			iter = pool.erase(iter);
+		}
+		else{
+			iter.next();
+		}
+	}
+
+	EXPECT_EQ(2000u, visited);
+
+	// Sweep away more in one pass
+	unsigned int erased = pool.sweep([&](uint32_t id, uint8_t* data){
+		EXPECT_EQ(id, *(uint32_t*)data);
+
+		if (id % 5)
+			return false;
+
+		alive[id] = false;
+		return true;
+	});
+
+	EXPECT_EQ(266u, erased);
+
+	unsigned int count = 0;
+
+	for (iter = pool.begin(); iter.valid(); iter.next()){
+		uint32_t id = iter.id();
+
+		EXPECT_TRUE(alive[id]);
+
+		for (unsigned int j = 0; j < 1 + id % 4; j++)
+			EXPECT_EQ(id, ((uint32_t*)iter.get())[j]);
+
+		count++;
+	}
+
+	EXPECT_EQ(pool.count(), count);
+	EXPECT_EQ((unsigned int)std::count(alive.begin(), alive.end(), true), count);
+
+	// Space freed by both is reused
+	for (unsigned int i = 0; i < 500; i++){
+		uint32_t id = pool.insert(sizeof(uint32_t));
+		*(uint32_t*)pool.get(id) = id;
+	}
+
+	for (iter = pool.begin(); iter.valid(); iter.next())
+		EXPECT_EQ(iter.id(), *(uint32_t*)iter.get());
+}
+
+TEST(ChunkPoolTest, MixedSizeReuse){
+	ChunkPool pool(256);
+
+	struct Block{
+		uint32_t id;
+		size_t size;
+		uint8_t value;
+	};
+
+	std::vector<Block> live;
+
+	srand(7);
+
+	// Erasing a block that isn't at the end of its chunk's array frees its own size, not the one moved into its slot
+	for (unsigned int round = 0; round < 20000; round++){
+		if (live.empty() || rand() % 3){
+			Block block = { 0, (size_t)(1 + rand() % 64), (uint8_t)rand() };
+
+			block.id = pool.insert(block.size);
+			std::memset(pool.get(block.id), block.value, block.size);
+
+			live.push_back(block);
+		}
+		else{
+			size_t index = rand() % live.size();
+
+			pool.erase(live[index].id);
+
+			live[index] = live.back();
+			live.pop_back();
+		}
+	}
+
+	EXPECT_EQ(live.size(), pool.count());
+
+	// Overlapping blocks would have overwritten each other
+	for (const Block& block : live){
+		uint8_t* data = pool.get(block.id);
+
+		for (size_t i = 0; i < block.size; i++)
+			ASSERT_EQ(block.value, data[i]);
+	}
+}
+
+TEST(ChunkPoolTest, EraseLastThroughIterator){
+	ChunkPool pool(1024);
+
+	for (unsigned int i = 0; i < 100; i++)
+		pool.insert(sizeof(TestObject));
+
+	// Erasing everything, the last erase hands back the end
+	ChunkPool::Iterator iter = pool.begin();
+	unsigned int erased = 0;
+
+	while (iter.valid()){
+		iter = pool.erase(iter);
+		erased++;
+	}
+
+	EXPECT_EQ(100u, erased);
+	EXPECT_EQ(0u, pool.count());
+	EXPECT_EQ(nullptr, iter.get());
+
+	// Only the final block
+	uint32_t last = 0;
+
+	for (unsigned int i = 0; i < 10; i++)
+		last = pool.insert(sizeof(TestObject));
+
+	for (iter = pool.begin(); iter.id() != last; iter.next());
+
+	iter = pool.erase(iter);
+
+	EXPECT_FALSE(iter.valid());
+	EXPECT_EQ(9u, pool.count());
 }
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "CommandBuffer.hpp"
+
+#include <gtest\gtest.h>
+#include <string>
+#include <vector>
+
+struct Seed{
+	unsigned int value;
+};
+
+struct Sprout{
+	unsigned int value;
+};
+
+TEST(CommandBufferTest, Parallel){
+	TypePool pool(4 * 1024);
+	WorkPool workers(4);
+
+	CommandBuffer commands(pool, workers);
+
+	for (unsigned int i = 0; i < 1000; i++)
+		pool.get<Seed>(pool.insert<Seed>(1))->value = i;
+
+	// Nothing changes until play, so every seed is visited exactly once
+	pool.executeParallel(workers, [&](const TypePool::Mask& mask, const Seed* seed){
+		commands.insert<Seed, Sprout>(*seed, Sprout{ seed->value * 2 });
+	}, 16);
+
+	EXPECT_FALSE(commands.empty());
+	EXPECT_EQ(1000u, pool.count());
+
+	commands.play();
+
+	EXPECT_TRUE(commands.empty());
+	EXPECT_EQ(2000u, pool.count());
+
+	unsigned int sprouts = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Seed* seed, const Sprout* sprout){
+		EXPECT_EQ(seed->value * 2, sprout->value);
+		sprouts++;
+	});
+
+	EXPECT_EQ(1000u, sprouts);
+}
+
+TEST(CommandBufferTest, Overflow){
+	TypePool pool(4 * 1024);
+	WorkPool workers(4);
+
+	// Fewer buffers than workers, the rest share one
+	CommandBuffer commands(pool, 2);
+
+	for (unsigned int i = 0; i < 1000; i++)
+		pool.get<Seed>(pool.insert<Seed>(1))->value = i;
+
+	pool.executeParallel(workers, [&](const TypePool::Mask& mask, const Seed* seed){
+		commands.insert<Sprout>(Sprout{ seed->value });
+	}, 16);
+
+	commands.play();
+
+	unsigned int total = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Sprout* sprout){
+		total += sprout->value;
+	});
+
+	EXPECT_EQ(999u * 1000u / 2u, total);
+}
+
+TEST(CommandBufferTest, Changes){
+	TypePool pool(4 * 1024);
+	CommandBuffer commands(pool);
+
+	std::vector<uint32_t> ids;
+
+	for (unsigned int i = 0; i < 10; i++)
+		ids.push_back(pool.insert<Seed>(1));
+
+	commands.erase(ids[0]);
+	commands.addComponent<Sprout>(ids[1], 2);
+	commands.addComponent<Sprout>(ids[2]);
+	commands.removeComponent<Sprout>(ids[2]);
+
+	commands.play();
+
+	EXPECT_EQ(9u, pool.count());
+	EXPECT_EQ(2u, pool.length<Sprout>(ids[1]));
+	EXPECT_EQ(0u, pool.length<Sprout>(ids[2]));
+	EXPECT_EQ(1u, pool.length<Seed>(ids[2]));
+}
+
+struct Label{
+	std::string text;
+};
+
+TEST(CommandBufferTest, NonTrivial){
+	TypePool pool(4 * 1024);
+
+	{
+		CommandBuffer commands(pool);
+
+		for (unsigned int i = 0; i < 100; i++)
+			commands.insert<Seed, Label>(Seed{ i }, Label{ std::string(64, 'a' + i % 26) });
+
+		commands.play();
+
+		// Never played, values are still freed
+		commands.insert<Label>(Label{ std::string(64, 'z') });
+	}
+
+	unsigned int found = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Seed* seed, const Label* label){
+		EXPECT_EQ(std::string(64, 'a' + seed->value % 26), label->text);
+		found++;
+	});
+
+	EXPECT_EQ(100u, found);
+	EXPECT_EQ(100u, pool.count());
+}
+
+struct alignas(64) Wide{
+	unsigned int value;
+};
+
+TEST(CommandBufferTest, Aligned){
+	TypePool pool(4 * 1024);
+	CommandBuffer commands(pool);
+
+	// Odd sized records in between, so the wide ones can't land on 64 by chance
+	for (unsigned int i = 0; i < 100; i++){
+		commands.insert<Seed>(Seed{ i });
+		commands.insert<Wide, Seed>(Wide{ i }, Seed{ i });
+	}
+
+	commands.play();
+
+	EXPECT_EQ(200u, pool.count());
+
+	unsigned int found = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Wide* wide, const Seed* seed){
+		EXPECT_EQ(0u, (uintptr_t)wide % alignof(Wide));
+		EXPECT_EQ(seed->value, wide->value);
+		found++;
+	});
+
+	EXPECT_EQ(100u, found);
+}
+
+struct Soil{
+	unsigned int richness;
+};
+
+TEST(CommandBufferTest, Shared){
+	TypePool pool(4 * 1024);
+	CommandBuffer commands(pool);
+
+	uint32_t poor = pool.share(Soil{ 100 });
+	uint32_t rich = pool.share(Soil{ 200 });
+
+	std::vector<uint32_t> ids;
+
+	for (unsigned int i = 0; i < 10; i++)
+		ids.push_back(pool.insert<Seed>(1));
+
+	// Shared values are given by handle, never copied over
+	for (unsigned int i = 0; i < 10; i++)
+		commands.addComponent<TypePool::Shared<Soil>>(ids[i], i % 2 ? rich : poor);
+
+	commands.play();
+
+	EXPECT_EQ(100u, pool.shared<Soil>(poor)->richness);
+	EXPECT_EQ(200u, pool.shared<Soil>(rich)->richness);
+
+	unsigned int richness = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Seed* seed, const TypePool::Shared<Soil>* soil){
+		richness += soil->richness;
+	});
+
+	EXPECT_EQ(5u * 100u + 5u * 200u, richness);
+	EXPECT_EQ(pool.shared<Soil>(rich), pool.get<TypePool::Shared<Soil>>(ids[1]));
+}
\ No newline at end of file
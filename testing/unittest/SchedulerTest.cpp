@@ -0,0 +1,60 @@
+#include "Scheduler.hpp"
+
+#include <gtest\gtest.h>
+
+struct Position{
+	float x;
+};
+
+struct Velocity{
+	float x;
+};
+
+struct Health{
+	int value;
+};
+
+TEST(SchedulerTest, Dependencies){
+	TypePool pool(32 * 1024);
+	WorkPool workers(4);
+
+	for (unsigned int i = 0; i < 1000; i++){
+		uint32_t id = pool.insert<Position, Velocity, Health>(1, 1, 1);
+		pool.get<Velocity>(id)->x = 1.f;
+	}
+
+	Scheduler scheduler(pool, workers);
+
+	uint32_t move = scheduler.add([](const TypePool::Mask& mask, Position* position, const Velocity* velocity){
+		position->x += velocity->x;
+	}, "Move");
+
+	uint32_t heal = scheduler.add([](const TypePool::Mask& mask, Health* health){
+		health->value++;
+	}, "Heal");
+
+	uint32_t check = scheduler.add([](const TypePool::Mask& mask, const Position* position, Health* health){
+		EXPECT_EQ((float)health->value, position->x);
+	}, "Check");
+
+	uint32_t damp = scheduler.add([](const TypePool::Mask& mask, Velocity* velocity){
+		velocity->x = 1.f;
+	}, "Damp");
+
+	EXPECT_FALSE(scheduler.dependsOn(heal, move));
+	EXPECT_TRUE(scheduler.dependsOn(check, move));
+	EXPECT_TRUE(scheduler.dependsOn(check, heal));
+	EXPECT_TRUE(scheduler.dependsOn(damp, move));
+	EXPECT_FALSE(scheduler.dependsOn(damp, check));
+
+	for (unsigned int i = 0; i < 10; i++)
+		scheduler.run();
+
+	pool.execute([](const TypePool::Mask& mask, Position* position, Health* health){
+		EXPECT_EQ(10.f, position->x);
+		EXPECT_EQ(10, health->value);
+	});
+
+	EXPECT_GT(scheduler.lastFrameTime(), 0.0);
+	EXPECT_GE(scheduler.averageTime(move), 0.0);
+}
\ No newline at end of file
@@ -1,6 +1,12 @@
 #include "TypePool.hpp"
 
 #include <gtest\gtest.h>
+#include <atomic>
+#include <algorithm>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
 
 struct Banana{
 	unsigned int x;
@@ -55,4 +61,955 @@ TEST(TypePoolTest, Testing){
 
 		return;
 	});
+}
+
+TEST(TypePoolTest, ExecuteParallel){
+	TypePool pool(32 * 1024);
+	WorkPool workers(4);
+
+	for (unsigned int i = 0; i < 10000; i++){
+		uint32_t id;
+
+		if (i % 2)
+			id = pool.insert<Banana, Dog>(1, 1);
+		else
+			id = pool.insert<Banana, Puzzle>(1, 1);
+
+		pool.get<Banana>(id)->x = i;
+	}
+
+	std::atomic<unsigned int> found(0);
+
+	pool.executeParallel(workers, [&](const TypePool::Mask& mask, const Banana* banana, Dog* dog){
+		EXPECT_EQ(1u, banana->x % 2);
+		dog->x = banana->x;
+		found++;
+	});
+
+	EXPECT_EQ(5000u, found.load());
+
+	pool.execute([&](const TypePool::Mask& mask, Banana* banana, Dog* dog){
+		EXPECT_EQ(banana->x, dog->x);
+	});
+}
+
+TEST(TypePoolTest, Access){
+	auto readBanana = TypePool::access([](const TypePool::Mask& mask, const Banana* banana, const Dog* dog){});
+	auto writeDog = TypePool::access([](const TypePool::Mask& mask, const Banana* banana, Dog* dog){});
+	auto writePuzzle = TypePool::access([](const TypePool::Mask& mask, Puzzle* puzzle){});
+
+	EXPECT_TRUE(readBanana.reads<Banana>());
+	EXPECT_FALSE(readBanana.writes<Banana>());
+	EXPECT_TRUE(writeDog.writes<Dog>());
+	EXPECT_FALSE(writeDog.reads<Puzzle>());
+
+	EXPECT_FALSE(readBanana.conflicts(readBanana));
+	EXPECT_TRUE(readBanana.conflicts(writeDog));
+	EXPECT_FALSE(writeDog.conflicts(writePuzzle));
+	EXPECT_TRUE(writePuzzle.conflicts(writePuzzle));
+}
+
+void insertErase(TypePool::Layout layout){
+	TypePool pool(4 * 1024, layout);
+
+	std::list<std::pair<uint32_t, unsigned int>> added;
+
+	for (unsigned int i = 0; i < 10000; i++){
+		uint32_t id;
+
+		switch (i % 3){
+		case 0:
+			id = pool.insert<Banana, Dog>(1, 1);
+			break;
+		case 1:
+			id = pool.insert<Dog, Wizard>(1, 2);
+			break;
+		default:
+			id = pool.insert<Banana, Dog, Puzzle>(1, 1, 3);
+			break;
+		}
+
+		pool.get<Dog>(id)->x = i;
+		added.push_back({ id, i });
+	}
+
+	auto iter = added.begin();
+
+	while (iter != added.end()){
+		if (!(rand() % 2)){
+			pool.erase(iter->first);
+			iter = added.erase(iter);
+		}
+		else{
+			iter++;
+		}
+	}
+
+	EXPECT_EQ(added.size(), pool.count());
+
+	for (auto& pair : added){
+		EXPECT_EQ(pair.second, pool.get<Dog>(pair.first)->x);
+		EXPECT_EQ(pair.second % 3 == 1 ? 2u : 0u, pool.length<Wizard>(pair.first));
+	}
+
+	unsigned int dogs = 0;
+	unsigned int bananas = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Dog* dog){
+		dogs++;
+	});
+
+	pool.execute([&](const TypePool::Mask& mask, const Banana* banana, const Dog* dog){
+		EXPECT_NE(1u, dog->x % 3);
+		bananas++;
+	});
+
+	EXPECT_EQ(added.size(), dogs);
+	EXPECT_EQ(added.size() - std::count_if(added.begin(), added.end(), [](const std::pair<uint32_t, unsigned int>& pair){ return pair.second % 3 == 1; }), bananas);
+}
+
+TEST(TypePoolTest, Archetypes){
+	insertErase(TypePool::Interleaved);
+}
+
+TEST(TypePoolTest, Columns){
+	insertErase(TypePool::Columns);
+
+	TypePool pool(4 * 1024, TypePool::Columns);
+
+	uint32_t idA = pool.insert<Banana, Puzzle>(1, 2);
+	uint32_t idB = pool.insert<Banana, Puzzle>(1, 2);
+
+	// Same types are next to each other in a column
+	EXPECT_EQ((uint8_t*)pool.get<Banana>(idA) + sizeof(Banana), (uint8_t*)pool.get<Banana>(idB));
+	EXPECT_EQ((uint8_t*)pool.get<Puzzle>(idA) + sizeof(Puzzle) * 2, (uint8_t*)pool.get<Puzzle>(idB));
+}
+
+TEST(TypePoolTest, ArchetypeLookup){
+	TypePool pool(16 * 1024, TypePool::Columns);
+
+	std::vector<uint32_t> ids;
+
+	// Enough archetypes to grow the lookup table a few times
+	for (unsigned int i = 1; i <= 200; i++)
+		ids.push_back(pool.insert<Dog, Banana>(1, i % 100 + 1));
+
+	// The same types and counts, in any order or through addComponent, find the same archetype (so land in the same column)
+	for (unsigned int i = 1; i <= 200; i++){
+		uint32_t id = i % 2 ? pool.insert<Banana, Dog>(i % 100 + 1, 1) : pool.insert<Dog>(1);
+
+		if (i % 2 == 0)
+			pool.addComponent<Banana>(id, i % 100 + 1);
+
+		// The last block given the same count
+		uint32_t previous = ids[i + 99];
+
+		EXPECT_EQ(pool.get<Dog>(previous) + 1, pool.get<Dog>(id));
+		EXPECT_EQ(i % 100 + 1, pool.length<Banana>(id));
+
+		ids.push_back(id);
+	}
+}
+
+TEST(TypePoolTest, Query){
+	TypePool pool(4 * 1024);
+	TypePool::Query query;
+
+	unsigned int found = 0;
+
+	auto count = [&](const TypePool::Mask& mask, const Dog* dog){
+		found++;
+	};
+
+	pool.insert<Banana, Dog>(1, 1);
+	pool.insert<Banana>(1);
+
+	pool.execute(query, count);
+	EXPECT_EQ(1u, found);
+
+	// New archetypes are picked up, existing ones aren't tested again
+	uint32_t id = pool.insert<Dog, Wizard>(1, 1);
+	pool.insert<Dog, Wizard>(1, 1);
+
+	found = 0;
+	pool.execute(query, count);
+	EXPECT_EQ(3u, found);
+
+	pool.erase(id);
+
+	WorkPool workers(2);
+	std::atomic<unsigned int> parallelFound(0);
+
+	pool.executeParallel(workers, query, [&](const TypePool::Mask& mask, const Dog* dog){
+		parallelFound++;
+	});
+
+	EXPECT_EQ(2u, parallelFound.load());
+}
+
+template <unsigned int N>
+struct Many{
+	unsigned int x;
+};
+
+template <unsigned int ...I>
+void insertMany(TypePool& pool, std::integer_sequence<unsigned int, I...>){
+	int inserted[] = { (pool.insert<Many<I>>(1), 0)... };
+	(void)inserted;
+}
+
+TEST(TypePoolTest, ManyTypes){
+	TypePool pool(32 * 1024);
+
+	// Registers 100 more types, well past a single 64 bit word
+	insertMany(pool, std::make_integer_sequence<unsigned int, 100>());
+
+	uint32_t idA = pool.insert<Many<3>, Many<90>, Many<99>>(1, 1, 1);
+	uint32_t idB = pool.insert<Many<3>, Many<90>>(1, 1);
+
+	pool.get<Many<90>>(idA)->x = 1;
+	pool.get<Many<90>>(idB)->x = 2;
+
+	unsigned int found = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, Many<3>* low, Many<90>* high){
+		found += high->x;
+	});
+
+	EXPECT_EQ(3u, found);
+
+	found = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, Many<90>* high, Many<99>* last){
+		found++;
+	});
+
+	EXPECT_EQ(1u, found);
+	EXPECT_EQ(1u, pool.length<Many<99>>(idA));
+	EXPECT_EQ(0u, pool.length<Many<99>>(idB));
+}
+
+struct Fixed{
+	unsigned int x;
+};
+
+TYPEPOOL_TYPE(Fixed, 5)
+
+TEST(TypePoolTest, RegisteredTypes){
+	// Fixed ids are known at compile time, automatic ids never overlap them
+	static_assert(TypePool::TypeId<Fixed>::value() == 5, "Registered id");
+	EXPECT_GE(TypePool::TypeId<Dog>::value(), (uint32_t)RESERVED_TYPES);
+	EXPECT_NE(TypePool::TypeId<Dog>::value(), TypePool::TypeId<Banana>::value());
+
+	TypePool pool(4 * 1024, TypePool::Columns);
+
+	uint32_t id = pool.insert<Dog, Fixed>(1, 2);
+	pool.get<Fixed>(id)[1].x = 7;
+
+	unsigned int found = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Fixed* fixed, Dog* dog){
+		found += fixed[1].x * mask.length<Fixed>();
+	});
+
+	EXPECT_EQ(14u, found);
+}
+
+struct Counted{
+	unsigned int x[4];
+};
+
+static unsigned int countedLookups = 0;
+
+// Counts every id lookup, so the test below can tell per block from per chunk
+template <> struct TypePool::TypeId<Counted>{ static uint32_t value(){ countedLookups++; return 6; } };
+
+TEST(TypePoolTest, ChunkLookups){
+	for (TypePool::Layout layout : { TypePool::Interleaved, TypePool::Columns }){
+		TypePool pool(4 * 1024, layout);
+
+		for (unsigned int i = 0; i < 1000; i++)
+			pool.get<Counted>(pool.insert<Counted, Dog>(1, 1))->x[0] = i;
+
+		countedLookups = 0;
+
+		unsigned int total = 0;
+
+		pool.execute([&](const TypePool::Mask& mask, Counted* counted, const Dog* dog){
+			total += counted->x[0];
+		});
+
+		pool.executeBatch([&](const TypePool::Mask& mask, uint32_t count, const uint32_t* ids, const Counted* counted, const Dog* dog){
+			for (uint32_t i = 0; i < count; i++)
+				total += counted[i].x[0];
+		});
+
+		EXPECT_EQ(999u * 1000u, total);
+
+		// Under 40 chunks of 1000 blocks, a lookup per block would be thousands
+		EXPECT_LT(countedLookups, 200u);
+	}
+}
+
+// Used before main, while the other statics in this file are still being initialized
+static TypePool earlyPool(4 * 1024);
+static uint32_t earlyId = earlyPool.insert<Dog, Banana>(1, 1);
+
+TEST(TypePoolTest, StaticInit){
+	unsigned int found = 0;
+
+	earlyPool.execute([&](const TypePool::Mask& mask, const Dog* dog, const Banana* banana){
+		found++;
+	});
+
+	EXPECT_EQ(1u, found);
+	EXPECT_EQ(1u, earlyPool.length<Dog>(earlyId));
+	EXPECT_EQ(0u, earlyPool.length<Puzzle>(earlyId));
+}
+
+void addRemove(TypePool::Layout layout){
+	TypePool pool(4 * 1024, layout);
+
+	std::vector<uint32_t> ids;
+
+	for (unsigned int i = 0; i < 200; i++){
+		uint32_t id = pool.insert<Dog, Puzzle>(1, 2);
+
+		pool.get<Dog>(id)->x = i;
+		pool.get<Puzzle>(id)[1].y = i;
+
+		ids.push_back(id);
+	}
+
+	// Every other block gains a Banana, moving them all out from under the rest
+	for (unsigned int i = 0; i < 200; i += 2){
+		Banana* banana = pool.addComponent<Banana>(ids[i]);
+
+		EXPECT_EQ(0u, banana->x);
+		banana->x = i;
+	}
+
+	// Resizing an array keeps what fits
+	pool.addComponent<Puzzle>(ids[10], 5);
+	EXPECT_EQ(5u, pool.length<Puzzle>(ids[10]));
+
+	pool.removeComponent<Dog>(ids[20]);
+	EXPECT_EQ(0u, pool.length<Dog>(ids[20]));
+
+	EXPECT_EQ(200u, pool.count());
+
+	for (unsigned int i = 0; i < 200; i++){
+		if (i != 20){
+			EXPECT_EQ(i, pool.get<Dog>(ids[i])->x);
+		}
+
+		EXPECT_EQ(i, pool.get<Puzzle>(ids[i])[1].y);
+
+		if (i % 2 == 0)
+			EXPECT_EQ(i, pool.get<Banana>(ids[i])->x);
+		else
+			EXPECT_EQ(0u, pool.length<Banana>(ids[i]));
+	}
+
+	unsigned int found = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Dog* dog, const Banana* banana){
+		found++;
+	});
+
+	EXPECT_EQ(99u, found);
+}
+
+TEST(TypePoolTest, AddRemoveComponent){
+	addRemove(TypePool::Interleaved);
+	addRemove(TypePool::Columns);
+}
+
+TEST(TypePoolTest, Filters){
+	TypePool pool(4 * 1024);
+
+	pool.get<Wizard>(pool.insert<Dog, Wizard>(1, 1))->x = 3;
+	pool.insert<Dog, Puzzle>(1, 1);
+	pool.insert<Dog>(1);
+	pool.insert<Banana>(1);
+
+	unsigned int found = 0;
+	unsigned int wizards = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const Dog* dog, const TypePool::Optional<Wizard>* wizard, TypePool::Without<Puzzle>* puzzle){
+		EXPECT_EQ(nullptr, puzzle);
+
+		if (wizard)
+			wizards += wizard->x;
+
+		found++;
+	});
+
+	EXPECT_EQ(2u, found);
+	EXPECT_EQ(3u, wizards);
+
+	// Filters are part of a query's signature too
+	TypePool::Query query;
+	found = 0;
+
+	pool.execute(query, [&](const TypePool::Mask& mask, TypePool::Without<Dog>*){
+		found++;
+	});
+
+	EXPECT_EQ(1u, found);
+
+	// Excluded types aren't accessed, optional ones are
+	TypePool::Access access = TypePool::access([](const TypePool::Mask& mask, TypePool::Optional<Wizard>* wizard, TypePool::Without<Puzzle>* puzzle){});
+
+	EXPECT_TRUE(access.writes<Wizard>());
+	EXPECT_FALSE(access.reads<Puzzle>());
+}
+
+TEST(TypePoolTest, ExecuteBatch){
+	for (TypePool::Layout layout : { TypePool::Interleaved, TypePool::Columns }){
+		TypePool pool(4 * 1024, layout);
+
+		std::vector<uint32_t> ids;
+
+		for (unsigned int i = 0; i < 500; i++){
+			uint32_t id = pool.insert<Dog, Banana>(1, 1);
+
+			pool.get<Banana>(id)->x = i;
+			ids.push_back(id);
+		}
+
+		unsigned int calls = 0;
+		unsigned int total = 0;
+
+		pool.executeBatch([&](const TypePool::Mask& mask, uint32_t count, const uint32_t* batchIds, Dog* dogs, const Banana* bananas){
+			for (uint32_t i = 0; i < count; i++){
+				dogs[i].x = bananas[i].x;
+				EXPECT_EQ(ids[bananas[i].x], batchIds[i]);
+			}
+
+			calls++;
+			total += count;
+		});
+
+		EXPECT_EQ(500u, total);
+
+		// Columns get whole chunks per call, interleaved blocks one at a time
+		if (layout == TypePool::Columns)
+			EXPECT_LT(calls, 50u);
+		else
+			EXPECT_EQ(500u, calls);
+
+		for (unsigned int i = 0; i < 500; i++)
+			EXPECT_EQ(i, pool.get<Dog>(ids[i])->x);
+
+		WorkPool workers(2);
+		std::atomic<unsigned int> parallelTotal(0);
+
+		pool.executeBatchParallel(workers, [&](const TypePool::Mask& mask, uint32_t count, const uint32_t* batchIds, const Dog* dogs){
+			parallelTotal += count;
+		}, 32);
+
+		EXPECT_EQ(500u, parallelTotal.load());
+	}
+}
+
+struct Enemy{};
+
+struct Boss{};
+
+TEST(TypePoolTest, Tags){
+	TypePool pool(4 * 1024);
+
+	// Tags take no space in the block
+	uint32_t id = pool.insert<Dog, Enemy>(1, 1);
+	pool.get<Dog>(id)->x = 4;
+
+	pool.insert<Enemy, Boss>(1, 1);
+	pool.insert<Enemy>(1);
+	pool.addComponent<Boss>(id);
+
+	unsigned int found = 0;
+	unsigned int bosses = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, Enemy* enemy, TypePool::Optional<Boss>* boss){
+		EXPECT_NE(nullptr, enemy);
+
+		if (boss)
+			bosses++;
+
+		found++;
+	});
+
+	EXPECT_EQ(3u, found);
+	EXPECT_EQ(2u, bosses);
+
+	pool.execute([&](const TypePool::Mask& mask, const Dog* dog, const Enemy* enemy, const Boss* boss){
+		EXPECT_EQ(4u, dog->x);
+	});
+
+	// Tags don't count as data access
+	EXPECT_FALSE(TypePool::access([](const TypePool::Mask& mask, Enemy* enemy){}).conflicts(TypePool::access([](const TypePool::Mask& mask, Enemy* enemy){})));
+}
+
+struct alignas(32) Wide{
+	float values[8];
+};
+
+struct Small{
+	uint8_t value;
+};
+
+TEST(TypePoolTest, Alignment){
+	for (TypePool::Layout layout : { TypePool::Interleaved, TypePool::Columns }){
+		TypePool pool(4 * 1024, layout);
+
+		std::vector<uint32_t> ids;
+
+		for (unsigned int i = 0; i < 300; i++){
+			uint32_t id = pool.insert<Small, Wide, double>(1, 2, 1);
+
+			pool.get<Small>(id)->value = (uint8_t)i;
+			pool.get<Wide>(id)[1].values[7] = (float)(uint8_t)i;
+
+			ids.push_back(id);
+		}
+
+		unsigned int found = 0;
+
+		pool.execute([&](const TypePool::Mask& mask, const Small* small, const Wide* wide, const double* number){
+			EXPECT_EQ(0u, (uintptr_t)wide % alignof(Wide));
+			EXPECT_EQ(0u, (uintptr_t)number % alignof(double));
+
+			EXPECT_EQ((float)small->value, wide[1].values[7]);
+			found++;
+		});
+
+		EXPECT_EQ(300u, found);
+	}
+}
+
+struct Inventory{
+	static int alive;
+
+	std::vector<int> items;
+	std::string name = "A name long enough to not fit in small string storage";
+	Inventory* self = this;
+
+	Inventory(){
+		alive++;
+	}
+
+	Inventory(Inventory&& other) : items(std::move(other.items)), name(std::move(other.name)){
+		alive++;
+	}
+
+	~Inventory(){
+		// Catches anything moved without its constructor
+		EXPECT_EQ(this, self);
+		alive--;
+	}
+};
+
+int Inventory::alive = 0;
+
+TEST(TypePoolTest, NonTrivial){
+	for (TypePool::Layout layout : { TypePool::Interleaved, TypePool::Columns }){
+		{
+			TypePool pool(4 * 1024, layout);
+
+			std::vector<uint32_t> ids;
+
+			// Enough to grow the ChunkPool several times over
+			for (unsigned int i = 0; i < 500; i++){
+				uint32_t id = pool.insert<Dog, Inventory>(1, 1);
+
+				pool.get<Dog>(id)->x = i;
+				pool.get<Inventory>(id)->items.push_back(i);
+
+				ids.push_back(id);
+			}
+
+			EXPECT_EQ(500, Inventory::alive);
+
+			for (unsigned int i = 0; i < 500; i += 3)
+				pool.erase(ids[i]);
+
+			EXPECT_EQ(333, Inventory::alive);
+
+			pool.addComponent<Banana>(ids[1]);
+			pool.addComponent<Inventory>(ids[2], 3);
+			pool.removeComponent<Inventory>(ids[4]);
+
+			EXPECT_EQ(334, Inventory::alive);
+			EXPECT_EQ(3u, pool.length<Inventory>(ids[2]));
+			EXPECT_FALSE(pool.get<Inventory>(ids[2])[2].name.empty());
+
+			for (unsigned int i = 0; i < 500; i++){
+				if (i % 3 == 0 || i == 4)
+					continue;
+
+				Inventory* inventory = pool.get<Inventory>(ids[i]);
+
+				ASSERT_EQ(1u, inventory->items.size());
+				EXPECT_EQ((int)i, inventory->items[0]);
+				EXPECT_EQ(inventory, inventory->self);
+			}
+		}
+
+		EXPECT_EQ(0, Inventory::alive);
+	}
+}
+
+TEST(TypePoolTest, GetMany){
+	TypePool pool(4 * 1024, TypePool::Columns);
+
+	uint32_t id = pool.insert<Banana, Dog, Puzzle, Enemy>(1, 1, 3, 1);
+
+	pool.get<Dog>(id)->x = 5;
+	pool.get<Puzzle>(id)[2].y = 6;
+
+	Dog* dog;
+	Puzzle* puzzle;
+	Banana* banana;
+	Enemy* enemy;
+
+	std::tie(dog, puzzle, banana, enemy) = pool.get<Dog, Puzzle, Banana, Enemy>(id);
+
+	EXPECT_EQ(5u, dog->x);
+	EXPECT_EQ(6u, puzzle[2].y);
+	EXPECT_EQ(pool.get<Banana>(id), banana);
+	EXPECT_NE(nullptr, enemy);
+}
+
+struct Name{
+	std::string text = "A name long enough to not fit in small string storage";
+};
+
+TEST(TypePoolTest, SpawnClone){
+	for (TypePool::Layout layout : { TypePool::Interleaved, TypePool::Columns }){
+		TypePool pool(4 * 1024, layout);
+
+		std::vector<uint32_t> ids(300);
+
+		// Spans several chunks, all taken in one go
+		pool.spawn<Dog, Puzzle>(300, ids.data(), 1, 2);
+
+		EXPECT_EQ(300u, pool.count());
+
+		for (unsigned int i = 0; i < 300; i++){
+			EXPECT_EQ(0u, pool.get<Dog>(ids[i])->x);
+			EXPECT_EQ(2u, pool.length<Puzzle>(ids[i]));
+
+			pool.get<Dog>(ids[i])->x = i;
+		}
+
+		std::sort(ids.begin(), ids.end());
+		EXPECT_TRUE(std::unique(ids.begin(), ids.end()) == ids.end());
+
+		// Copies of a prototype, including arrays and non-trivial types
+		uint32_t prototype = pool.insert<Dog, Puzzle, Name, Enemy>(1, 2, 1, 1);
+
+		pool.get<Dog>(prototype)->x = 7;
+		pool.get<Puzzle>(prototype)[1].y = 8;
+		pool.get<Name>(prototype)->text += "!";
+
+		std::vector<uint32_t> clones(250);
+
+		pool.clone(prototype, 250, clones.data());
+		pool.clone(ids[5], 10);
+
+		EXPECT_EQ(561u, pool.count());
+
+		for (uint32_t clone : clones){
+			EXPECT_EQ(7u, pool.get<Dog>(clone)->x);
+			EXPECT_EQ(8u, pool.get<Puzzle>(clone)[1].y);
+			EXPECT_EQ(pool.get<Name>(prototype)->text, pool.get<Name>(clone)->text);
+			EXPECT_EQ(1u, pool.length<Enemy>(clone));
+		}
+
+		unsigned int found = 0;
+
+		pool.execute([&](const TypePool::Mask& mask, const Dog* dog, TypePool::Without<Name>*){
+			if (dog->x == 5)
+				found++;
+		});
+
+		EXPECT_EQ(11u, found);
+	}
+}
+
+void changes(TypePool::Layout layout){
+	TypePool pool(4 * 1024, layout);
+
+	std::vector<uint32_t> ids(300);
+
+	pool.spawn<Dog, Banana>(300, ids.data(), 1, 1);
+
+	unsigned int found = 0;
+
+	auto count = [&](const TypePool::Mask& mask, const TypePool::Changed<Dog>* dog){
+		found++;
+	};
+
+	// New blocks count as changed
+	pool.execute(count);
+	EXPECT_EQ(300u, found);
+
+	pool.tick();
+
+	found = 0;
+	pool.execute(count);
+	EXPECT_EQ(0u, found);
+
+	// Reading doesn't count, writing does
+	pool.execute([](const TypePool::Mask& mask, const Dog* dog, Banana* banana){});
+	pool.get<Dog>(ids[10])->x = 1;
+	pool.get<const Dog>(ids[20]);
+	pool.get<Banana, Dog>(ids[30]);
+
+	found = 0;
+	pool.execute(count);
+	EXPECT_EQ(2u, found);
+
+	// Erasing moves the last block but not its changes
+	pool.erase(ids[0]);
+
+	found = 0;
+	pool.execute([&](const TypePool::Mask& mask, const TypePool::Changed<Dog>* dog){
+		EXPECT_TRUE(dog == pool.get<const Dog>(ids[10]) || dog == pool.get<const Dog>(ids[30]));
+		found++;
+	});
+
+	EXPECT_EQ(2u, found);
+
+	pool.tick();
+
+	// Only changed blocks are passed in batches, and writes through them are stamped
+	pool.get<Dog>(ids[100]);
+	pool.get<Dog>(ids[101]);
+
+	found = 0;
+	pool.executeBatch([&](const TypePool::Mask& mask, uint32_t count, const uint32_t* batchIds, const TypePool::Changed<Dog>* dogs, Banana* bananas){
+		for (uint32_t i = 0; i < count; i++){
+			EXPECT_TRUE(batchIds[i] == ids[100] || batchIds[i] == ids[101]);
+			found++;
+		}
+	});
+
+	EXPECT_EQ(2u, found);
+
+	found = 0;
+	pool.execute([&](const TypePool::Mask& mask, const TypePool::Changed<Banana>* banana){
+		found++;
+	});
+
+	EXPECT_EQ(2u, found);
+}
+
+TEST(TypePoolTest, Changes){
+	changes(TypePool::Interleaved);
+	changes(TypePool::Columns);
+}
+
+void doubleBuffered(TypePool::Layout layout){
+	TypePool pool(4 * 1024, layout);
+
+	std::vector<uint32_t> ids(300);
+
+	pool.spawn<Dog, TypePool::Previous<Dog>, Banana>(300, ids.data(), 1, 1, 1);
+
+	uint32_t single = pool.insert<Dog>(1);
+
+	auto advance = [](const TypePool::Mask& mask, Dog* dog, const TypePool::Previous<Dog>* previous){
+		dog->x = previous->x + 1;
+	};
+
+	auto read = [](const TypePool::Mask& mask, const TypePool::Previous<Dog>* previous, Banana* banana){
+		banana->x = previous->x;
+	};
+
+	// Readers of the previous copy don't wait on writers of the current one
+	EXPECT_FALSE(TypePool::access(advance).conflicts(TypePool::access(read)));
+
+	for (unsigned int frame = 0; frame < 3; frame++){
+		pool.execute(advance);
+		pool.execute(read);
+
+		pool.tick();
+	}
+
+	for (uint32_t id : ids){
+		EXPECT_EQ(3u, pool.get<const Dog>(id)->x);
+		EXPECT_EQ(3u, pool.get<const TypePool::Previous<Dog>>(id)->x);
+		EXPECT_EQ(2u, pool.get<const Banana>(id)->x);
+	}
+
+	// Blocks without the second copy are left alone
+	EXPECT_EQ(0u, pool.get<const Dog>(single)->x);
+
+	// Only changed data is copied, and writes made outside execute count too
+	pool.get<Dog>(ids[7])->x = 10;
+	pool.tick();
+
+	EXPECT_EQ(10u, pool.get<const TypePool::Previous<Dog>>(ids[7])->x);
+	EXPECT_EQ(3u, pool.get<const TypePool::Previous<Dog>>(ids[8])->x);
+}
+
+TEST(TypePoolTest, DoubleBuffered){
+	doubleBuffered(TypePool::Interleaved);
+	doubleBuffered(TypePool::Columns);
+}
+
+struct Material{
+	std::string name;
+	unsigned int passes;
+};
+
+TEST(TypePoolTest, Shared){
+	for (TypePool::Layout layout : { TypePool::Interleaved, TypePool::Columns }){
+		TypePool pool(4 * 1024, layout);
+
+		uint32_t stone = pool.share(Material{ "Stone", 1 });
+		uint32_t glass = pool.share(Material{ "Glass", 2 });
+
+		std::vector<uint32_t> stones(200);
+		std::vector<uint32_t> glasses(100);
+
+		pool.spawn<Dog, TypePool::Shared<Material>>(200, stones.data(), 1, stone);
+		pool.spawn<Dog, TypePool::Shared<Material>>(100, glasses.data(), 1, glass);
+
+		uint32_t plain = pool.insert<Dog>(1);
+
+		// Shared values take no space in blocks
+		pool.execute([&](const TypePool::Mask& mask, const Dog* dog, const TypePool::Shared<Material>* material){
+			EXPECT_EQ(material == pool.shared<Material>(stone) ? 1u : 2u, material->passes);
+		});
+
+		EXPECT_EQ(pool.shared<Material>(stone), pool.get<TypePool::Shared<Material>>(stones[5]));
+		EXPECT_EQ(1u, pool.length<TypePool::Shared<Material>>(stones[5]));
+
+		unsigned int passes = 0;
+
+		pool.executeBatch([&](const TypePool::Mask& mask, uint32_t count, const uint32_t* ids, Dog* dogs, const TypePool::Shared<Material>* material){
+			passes += count * material->passes;
+		});
+
+		EXPECT_EQ(400u, passes);
+
+		// Changing the value changes it for every block at once
+		pool.shared<Material>(glass)->passes = 3;
+
+		// Blocks switch values by moving to another archetype
+		pool.addComponent<TypePool::Shared<Material>>(plain, glass);
+		pool.addComponent<TypePool::Shared<Material>>(stones[0], glass);
+		pool.removeComponent<TypePool::Shared<Material>>(stones[1]);
+
+		EXPECT_EQ(0u, pool.length<TypePool::Shared<Material>>(stones[1]));
+		EXPECT_EQ("Glass", pool.get<TypePool::Shared<Material>>(plain)->name);
+
+		passes = 0;
+
+		pool.execute([&](const TypePool::Mask& mask, const TypePool::Shared<Material>* material){
+			passes += material->passes;
+		});
+
+		EXPECT_EQ(198u + 102u * 3u, passes);
+
+		// Reading a shared value conflicts with writing it, like anything else
+		auto read = [](const TypePool::Mask& mask, const TypePool::Shared<Material>* material){};
+		auto write = [](const TypePool::Mask& mask, TypePool::Shared<Material>* material){};
+
+		EXPECT_TRUE(TypePool::access(read).conflicts(TypePool::access(write)));
+	}
+}
+
+TEST(TypePoolTest, Cursor){
+	TypePool pool(4 * 1024);
+
+	std::vector<uint32_t> ids(300);
+
+	pool.spawn<Dog>(200, ids.data(), 1);
+	pool.spawn<Dog, Banana>(100, ids.data() + 200, 1, 1);
+
+	std::vector<unsigned int> visits(ids.size());
+
+	auto count = [&](const TypePool::Mask& mask, Dog* dog){
+		visits[dog->x]++;
+	};
+
+	for (unsigned int i = 0; i < ids.size(); i++)
+		pool.get<Dog>(ids[i])->x = i;
+
+	TypePool::Cursor cursor;
+
+	// A whole pass, a slice at a time
+	unsigned int slices = 1;
+
+	while (!pool.execute(cursor, 64, count))
+		slices++;
+
+	EXPECT_EQ(5u, slices);
+	EXPECT_EQ(1u, cursor.passes());
+	EXPECT_TRUE(std::all_of(visits.begin(), visits.end(), [](unsigned int v){ return v == 1; }));
+
+	// Erasing and inserting between slices never loses a block that stays
+	std::fill(visits.begin(), visits.end(), 0);
+
+	EXPECT_FALSE(pool.execute(cursor, 50, count));
+
+	for (unsigned int i = 0; i < 300; i += 7){
+		pool.erase(ids[i]);
+		ids[i] = UINT32_MAX;
+	}
+
+	pool.insert<Dog, Wizard>(1, 1);
+
+	EXPECT_FALSE(pool.execute(cursor, 100, count));
+	EXPECT_TRUE(pool.execute(cursor, 1000, count));
+
+	for (unsigned int i = 0; i < ids.size(); i++){
+		if (ids[i] != UINT32_MAX){
+			EXPECT_LE(1u, visits[i]);
+		}
+	}
+
+	// Time slices always make some progress
+	while (!pool.execute(cursor, std::chrono::microseconds(0), count));
+
+	EXPECT_EQ(3u, cursor.passes());
+}
+
+TEST(TypePoolTest, CursorChanges){
+	TypePool pool(4 * 1024);
+
+	std::vector<uint32_t> ids(200);
+
+	pool.spawn<Dog, TypePool::Previous<Dog>>(200, ids.data(), 1, 1);
+	pool.tick();
+
+	// A slice ending partway through a chunk still marks the chunk
+	TypePool::Cursor cursor;
+
+	EXPECT_FALSE(pool.execute(cursor, 10u, [](const TypePool::Mask& mask, Dog* dog){
+		dog->x = 1;
+	}));
+
+	unsigned int changed = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const TypePool::Changed<Dog>* dog){
+		EXPECT_EQ(1u, dog->x);
+		changed++;
+	});
+
+	EXPECT_EQ(10u, changed);
+
+	pool.tick();
+
+	unsigned int copied = 0;
+
+	pool.execute([&](const TypePool::Mask& mask, const TypePool::Previous<Dog>* previous){
+		copied += previous->x;
+	});
+
+	EXPECT_EQ(10u, copied);
 }
\ No newline at end of file
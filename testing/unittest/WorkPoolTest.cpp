@@ -0,0 +1,40 @@
+#include "WorkPool.hpp"
+
+#include <gtest\gtest.h>
+#include <atomic>
+#include <vector>
+
+TEST(WorkPoolTest, RunsEveryTask){
+	WorkPool workers(4);
+
+	for (uint32_t count : { 1u, 3u, 4u, 1000u }){
+		std::vector<std::atomic<unsigned int>> ran(count);
+
+		for (auto& value : ran)
+			value = 0;
+
+		workers.run(count, [&](uint32_t task){
+			ran[task]++;
+		});
+
+		for (uint32_t i = 0; i < count; i++)
+			EXPECT_EQ(1u, ran[i].load());
+	}
+}
+
+TEST(WorkPoolTest, Deterministic){
+	WorkPool workers(4);
+
+	std::vector<unsigned int> first(1000);
+	std::vector<unsigned int> second(1000);
+
+	workers.run(1000, [&](uint32_t task){
+		first[task] = WorkPool::worker();
+	}, true);
+
+	workers.run(1000, [&](uint32_t task){
+		second[task] = WorkPool::worker();
+	}, true);
+
+	EXPECT_EQ(first, second);
+}
\ No newline at end of file